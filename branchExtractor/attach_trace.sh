@@ -0,0 +1,37 @@
+#!/bin/bash
+# Usage: attach_trace.sh <pid> <trace_name> [<conditional branches>]
+#
+# Attaches to a running process, logs conditional branches until the first
+# thread has logged <conditional branches> (10000000 by default) and
+# detaches, so the process keeps running at native speed afterwards.
+BRANCH_EXT_ROOT=$(dirname $(realpath -s $0))
+LIMIT=${3:-10000000}
+
+make -C ${BRANCH_EXT_ROOT}
+
+source ${BRANCH_EXT_ROOT}/compress_logs.sh
+
+# The tool runs inside the target process, so it gets absolute paths for
+# both of its outputs. `pin -pid` returns as soon as the tool is injected;
+# the compressors end when the tool closes the logs on detach.
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+start_log_compressors "${WORK_DIR}" "$2"
+
+if ! ${BRANCH_EXT_ROOT}/pin_tool/pin -pid $1 -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so \
+        -o "${WORK_DIR}/branches" -i "${WORK_DIR}/generalInfo" -f 0 -l ${LIMIT} -d 1 -z 1 ${BRANCH_EXT_ARGS}; then
+    echo "Failed to attach to process $1"
+    touch "${WORK_DIR}/branches.done"
+    wait ${LOG_COMPRESSORS_PID}
+    exit 1
+fi
+
+echo "Attached to process $1, waiting for ${LIMIT} conditional branches"
+wait ${LOG_COMPRESSORS_PID}
+
+# Every thread, and every sample in sampling mode, has its own
+# generalInfo_<sample>[_t<tid>].out, named after its trace
+for LOG in "${WORK_DIR}"/branches_*.out; do
+    INFO="${WORK_DIR}/generalInfo${LOG#${WORK_DIR}/branches}"
+    [ -e "${INFO}" ] && mv "${INFO}" "$2$(log_suffix "${LOG}").txt"
+done
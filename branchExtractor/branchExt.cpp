@@ -55,38 +55,78 @@ END_LEGAL */
 #include <fstream>
 #include <cstdlib>
 #include <map>
+#include <vector>
+#include <sys/stat.h>
 #include "pin.H"
 #include "instlib.H"
 
 using namespace std;
 
-#define axuliryFileName "generalInfo"
 std::map<ADDRINT, std::string> disAssemblyMap;
 
 static ADDRINT dl_debug_state_Addr = 0;
 static ADDRINT dl_debug_state_AddrEnd = 0;
 static BOOL justFoundDlDebugState = FALSE;
 
-ofstream OutFile;
-ofstream axuFile;
-// The running count of instructions is kept here
-// make it static to help the compiler optimize docount
-static UINT64 icount = 0;
-static UINT64 cbcount = 0;
-static UINT64 ubcount = 0;
-static UINT64 callcount = 0;
-static UINT64 retcount = 0;
+// Every application thread gets its own trace state: output files, counters
+// and set index. Analysis routines only ever touch the state of the thread
+// that runs them, so the hot path needs no locking and records of different
+// threads never interleave. Thread 0 writes `<prefix>_<set>.out` and
+// `generalInfo_<set>.out` as before; thread N writes `<prefix>_<set>_tN.out`
+// and `generalInfo_<set>_tN.out`.
+struct thread_data_t
+{
+    THREADID tid;
+    ofstream OutFile;
+    ofstream axuFile;
+    // The running count of instructions is kept here
+    UINT64 icount;
+    UINT64 cbcount;
+    UINT64 ubcount;
+    UINT64 callcount;
+    UINT64 retcount;
+    UINT64 fileCounter;
+    UINT64 first_inst_count_after_offset;
+    UINT64 prev_cbcount;
+    // Instructions executed inside the current sample (sampling mode only)
+    UINT64 chunk_icount;
+    // Conditional branches logged in the earlier samples (sampling mode only)
+    UINT64 sampled_cbcount;
+    bool closed;
+};
+
+static TLS_KEY tls_key = INVALID_TLS_KEY;
+// Only touched from thread start/fini callbacks and Fini, never from analysis routines
+static PIN_LOCK threads_lock;
+static std::vector<thread_data_t *> threads;
+
 static int64_t howManyBranch = 0;
 static UINT64 howManySet = 0;
-static UINT64 fileCounter = 0;
 static UINT64 offset_inst = 0;
-static UINT64 first_inst_count_after_offset = 0;
 static bool first_record = true;
 static bool record = false;
-static ostringstream filePrefix;
 
 static UINT64 CBCOUNT_LIMIT = 10000000;
-static UINT64 prev_cbcount = -1;
+// Logged addresses are truncated to 32 bits unless -w 64 is given
+static ADDRINT addr_mask = 0xffffffff;
+// Detach instead of terminating the application once CBCOUNT_LIMIT is reached
+static bool detach_on_limit = false;
+// Set once the capture window is over; analysis routines stop logging
+static volatile bool capture_done = false;
+// Create every branch log as a named pipe, for the scripts to compress
+static bool fifo_logs = false;
+
+// Sampling mode: a window of sample_len conditional branches is logged every
+// sample_period instructions, each into its own indexed chunk. Between
+// windows only basic-block instruction counts are instrumented. Thread 0 is
+// the clock that opens and closes the windows; it is the only writer of the
+// sample_* state, the other threads just follow it.
+static UINT64 sample_len = 0;
+static UINT64 sample_period = 0;
+static UINT64 next_sample_start = 0;
+static UINT64 samples_taken = 0;
+static volatile bool sample_active = false;
+static volatile UINT64 sample_chunk = 0;
 
 KNOB<string> KnobOutputFile(KNOB_MODE_WRITEONCE, "pintool", "o", "branches", "specifies the output file name prefix.");
 
@@ -97,104 +137,293 @@ KNOB<string> KnobHowManyBranch(KNOB_MODE_WRITEONCE, "pintool", "m", "-1", "Speci
 KNOB<string> KnobOffset(KNOB_MODE_WRITEONCE, "pintool", "f", "20000000", "Starts saving instructions after seeing the first `f` instruction.");
 // KNOB<string> KnobOffset(KNOB_MODE_WRITEONCE, "pintool", "f", "0", "Starts saving instructions after seeing the first `f` instruction.");
 
-VOID write_on_axu()
+KNOB<string> KnobInfoFile(KNOB_MODE_WRITEONCE, "pintool", "i", "generalInfo", "specifies the general information file name prefix.");
+
+KNOB<string> KnobLimit(KNOB_MODE_WRITEONCE, "pintool", "l", "10000000", "Ends the capture of the whole process once any thread has logged `l` conditional branches.");
+
+KNOB<string> KnobDetach(KNOB_MODE_WRITEONCE, "pintool", "d", "0", "Detaches from the application instead of terminating it once `l` is reached. Always on when attached with -pid.");
+
+KNOB<string> KnobAddressWidth(KNOB_MODE_WRITEONCE, "pintool", "w", "32", "Width in bits of the logged branch and target addresses, 32 or 64.");
+
+KNOB<string> KnobSampleLength(KNOB_MODE_WRITEONCE, "pintool", "s", "0", "Sampling mode: logs `s` conditional branches per sample, 0 to log one contiguous window.");
+
+KNOB<string> KnobSamplePeriod(KNOB_MODE_WRITEONCE, "pintool", "p", "100000000", "Sampling mode: starts a new sample every `p` instructions.");
+
+KNOB<string> KnobFifo(KNOB_MODE_WRITEONCE, "pintool", "z", "0", "Creates each branch log as a named pipe and writes `<o>.done` once all of them are closed, so that a compressor can drain each one as it is written.");
+
+static inline thread_data_t *get_tls(THREADID tid)
+{
+    return static_cast<thread_data_t *>(PIN_GetThreadData(tls_key, tid));
+}
+
+string file_name(const string &prefix, thread_data_t *td)
+{
+    ostringstream filePrefix;
+    filePrefix << prefix << "_" << td->fileCounter;
+    if (td->tid != 0)
+        filePrefix << "_t" << td->tid;
+    filePrefix << ".out";
+    return filePrefix.str();
+}
+
+VOID open_files(thread_data_t *td)
 {
-    axuFile << "!!! Number of Instructions = " << (icount - offset_inst - ((fileCounter - 1) * howManyBranch) + 1) << endl;
-    axuFile << "!!! Number of Unconditional branches = " << ubcount << endl;
-    axuFile << "!!! Number of Conditional branches = " << cbcount << endl;
-    axuFile << "!!! Number of Call branches = " << callcount << endl;
-    axuFile << "!!! Number of Ret branches = " << retcount << endl;
+    string log = file_name(KnobOutputFile.Value(), td);
+    // Opening the pipe waits for the compressor the scripts start on it
+    if (fifo_logs)
+        mkfifo(log.c_str(), 0644);
+    td->OutFile.open(log.c_str());
+    td->OutFile.setf(ios::showbase);
+
+    td->axuFile.open(file_name(KnobInfoFile.Value(), td).c_str());
+    td->axuFile.setf(ios::showbase);
+}
+
+VOID write_on_axu(thread_data_t *td)
+{
+    if (sample_len > 0)
+        td->axuFile << "!!! Number of Instructions = " << td->chunk_icount << endl;
+    else
+        td->axuFile << "!!! Number of Instructions = " << (td->icount - offset_inst - ((td->fileCounter - 1) * howManyBranch) + 1) << endl;
+    td->axuFile << "!!! Number of Unconditional branches = " << td->ubcount << endl;
+    td->axuFile << "!!! Number of Conditional branches = " << td->cbcount << endl;
+    td->axuFile << "!!! Number of Call branches = " << td->callcount << endl;
+    td->axuFile << "!!! Number of Ret branches = " << td->retcount << endl;
+
+    td->axuFile.close();
+}
 
-    axuFile.close();
+VOID close_files(thread_data_t *td)
+{
+    if (td->closed)
+        return;
+    write_on_axu(td);
+    td->OutFile.close();
+    td->closed = true;
 }
 
 VOID Fini(INT32 code, VOID *v)
 {
     // Write to a file since cout and cerr maybe closed by the application
     cout << "Logging data..." << endl;
-    write_on_axu();
-    OutFile.close();
+    PIN_GetLock(&threads_lock, 0);
+    for (size_t i = 0; i < threads.size(); i++)
+        close_files(threads[i]);
+    PIN_ReleaseLock(&threads_lock);
+
+    if (fifo_logs)
+    {
+        ofstream done((KnobOutputFile.Value() + ".done").c_str());
+    }
+}
+
+// Called once every thread is stopped inside the VM, right before the
+// application goes back to running natively
+VOID DetachFini(VOID *v)
+{
+    cout << "Detaching..." << endl;
+    Fini(0, v);
+}
+
+// Ends the capture window of an attached run. The first thread to reach the
+// limit requests the detach; PIN_Detach is asynchronous, so the analysis
+// routines check capture_done to avoid logging past the window meanwhile.
+VOID stop_capture(THREADID tid)
+{
+    PIN_GetLock(&threads_lock, tid + 1);
+    if (!capture_done)
+    {
+        capture_done = true;
+        cout << "Detaching because of CBCOUNT_LIMIT" << endl;
+        PIN_Detach();
+    }
+    PIN_ReleaseLock(&threads_lock);
+}
+
+VOID ThreadStart(THREADID tid, CONTEXT *ctxt, INT32 flags, VOID *v)
+{
+    thread_data_t *td = new thread_data_t();
+    td->tid = tid;
+    td->icount = 0;
+    td->cbcount = 0;
+    td->ubcount = 0;
+    td->callcount = 0;
+    td->retcount = 0;
+    td->fileCounter = 0;
+    td->first_inst_count_after_offset = 0;
+    td->prev_cbcount = -1;
+    td->chunk_icount = 0;
+    td->sampled_cbcount = 0;
+    td->closed = false;
+    open_files(td);
+
+    PIN_SetThreadData(tls_key, td, tid);
+
+    PIN_GetLock(&threads_lock, tid + 1);
+    threads.push_back(td);
+    PIN_ReleaseLock(&threads_lock);
 }
 
-VOID reset_var()
+VOID ThreadFini(THREADID tid, const CONTEXT *ctxt, INT32 code, VOID *v)
 {
-    cbcount = 0;
-    ubcount = 0;
-    callcount = 0;
-    retcount = 0;
-    first_inst_count_after_offset = 0;
+    thread_data_t *td = get_tls(tid);
+
+    PIN_GetLock(&threads_lock, tid + 1);
+    close_files(td);
+    PIN_ReleaseLock(&threads_lock);
 }
 
-UINT32 file_init()
+VOID reset_var(thread_data_t *td)
 {
-    cout << "Writing " << fileCounter - 1 << endl;
+    td->cbcount = 0;
+    td->ubcount = 0;
+    td->callcount = 0;
+    td->retcount = 0;
+    td->first_inst_count_after_offset = 0;
+}
 
-    write_on_axu();
+UINT32 file_init(thread_data_t *td)
+{
+    cout << "Writing " << td->fileCounter - 1 << endl;
 
-    OutFile.close();
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << KnobOutputFile.Value() << "_" << fileCounter << ".out";
-    OutFile.open(filePrefix.str().c_str());
-    OutFile.setf(ios::showbase);
+    write_on_axu(td);
 
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << axuliryFileName << "_" << fileCounter << ".out";
-    axuFile.open(filePrefix.str().c_str());
-    axuFile.setf(ios::showbase);
+    td->OutFile.close();
+    open_files(td);
 
-    reset_var();
+    reset_var(td);
 
     return 0;
 }
 
 // This function is called before every instruction is executed
-VOID docount()
+VOID docount(THREADID tid)
 {
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+
     // cerr<< "I:" << icount << "V:" << (howManyBranch+ offset_inst - 1) << (!((icount) % (howManyBranch+ offset_inst - 1))? "Tr":"Fa") << endl;
     if (howManyBranch > 0)
     {
-        if (!((icount) % ((howManyBranch * (fileCounter + 1)) + offset_inst - 1)) && icount > 0)
+        if (!((td->icount) % ((howManyBranch * (td->fileCounter + 1)) + offset_inst - 1)) && td->icount > 0)
         {
-            fileCounter++;
-            if (fileCounter > howManySet - 1)
+            td->fileCounter++;
+            if (td->fileCounter > howManySet - 1)
             {
                 cout << "Exiting because of user conditions" << endl;
-                Fini(0, 0);
-                exit(0);
+                // Stops the other threads before Fini closes their files
+                PIN_ExitApplication(0);
             }
             else
             {
-                file_init();
+                file_init(td);
             }
         }
     }
 
-    icount++;
+    td->icount++;
 
-    if (cbcount != prev_cbcount && cbcount % 10000 == 0)
-        cout << icount << " "<< cbcount << endl;
-    prev_cbcount = cbcount;
+    if (td->cbcount != td->prev_cbcount && td->cbcount % 10000 == 0)
+        cout << td->icount << " "<< td->cbcount << endl;
+    td->prev_cbcount = td->cbcount;
 
-    if (cbcount >= CBCOUNT_LIMIT)
+    if (td->cbcount >= CBCOUNT_LIMIT)
     {
-        fileCounter++;
+        if (detach_on_limit)
+        {
+            stop_capture(tid);
+            return;
+        }
+        td->fileCounter++;
         cout << "Exiting because of CBCOUNT_LIMIT" << endl;
-        Fini(0, 0);
-        exit(0);
+        PIN_ExitApplication(0);
     }
 
-    if (icount >= offset_inst && fileCounter == 0)
+    if (td->icount >= offset_inst && td->fileCounter == 0)
     {
         // cout << "Here!" << endl;
-        first_inst_count_after_offset++; // Although here is going to be increased by one, it will be set to 1 whenever it reaches to fist branch;
+        td->first_inst_count_after_offset++; // Although here is going to be increased by one, it will be set to 1 whenever it reaches to fist branch;
         record = true;
     }
-    else if (fileCounter > 0)
+    else if (td->fileCounter > 0)
+    {
+        td->first_inst_count_after_offset++;
+    }
+}
+
+// Moves the thread on to the files of the current sample
+VOID next_chunk(thread_data_t *td)
+{
+    write_on_axu(td);
+    td->OutFile.close();
+    td->fileCounter = sample_chunk;
+    open_files(td);
+    td->sampled_cbcount += td->cbcount;
+    reset_var(td);
+    td->chunk_icount = 0;
+}
+
+VOID start_sample(thread_data_t *td)
+{
+    if (samples_taken > 0)
+    {
+        sample_chunk++;
+        next_chunk(td);
+    }
+    next_sample_start += sample_period;
+    cout << "Sample " << sample_chunk << " at instruction " << td->icount << endl;
+
+    sample_active = true;
+    // Re-JIT everything with the branch logging calls in place
+    PIN_RemoveInstrumentation();
+}
+
+VOID end_sample(thread_data_t *td)
+{
+    sample_active = false;
+    samples_taken++;
+    PIN_RemoveInstrumentation();
+}
+
+// Called once per basic block between samples
+VOID GapCount(THREADID tid, UINT32 numIns)
+{
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->icount += numIns;
+
+    if (tid == 0 && !sample_active && td->icount >= next_sample_start)
+        start_sample(td);
+}
+
+// Called once per basic block inside a sample
+VOID SampleCount(THREADID tid, UINT32 numIns)
+{
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    if (td->fileCounter != sample_chunk)
+        next_chunk(td);
+    td->icount += numIns;
+    td->chunk_icount += numIns;
+
+    // -l counts each thread over all of its samples, as it does the
+    // contiguous window, and the first thread to reach it ends the capture
+    if (td->sampled_cbcount + td->cbcount >= CBCOUNT_LIMIT)
     {
-        first_inst_count_after_offset++;
+        if (detach_on_limit)
+        {
+            stop_capture(tid);
+            return;
+        }
+        cout << "Exiting because of CBCOUNT_LIMIT" << endl;
+        PIN_ExitApplication(0);
     }
+
+    if (tid == 0 && sample_active && (td->cbcount >= sample_len || td->icount >= next_sample_start))
+        end_sample(td);
 }
 
 VOID ImageLoad(IMG img, VOID *v)
@@ -229,64 +458,71 @@ VOID ImageLoad(IMG img, VOID *v)
  *
  */
 
-static VOID UnconDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconDirectJMP(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
+            << "\n";
+    td->ubcount++;
 }
 
-static VOID UnconUnDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconUnDirectJMP(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    ubcount++;
+            << "\n";
+    td->ubcount++;
 }
 
-static VOID ConDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConDirectJMP(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Conditional
             << "\t0"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
+            << "\n";
+    td->cbcount++;
 }
-static VOID ConUnDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConUnDirectJMP(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Conditional
             << "\t0"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    cbcount++;
+            << "\n";
+    td->cbcount++;
 }
 //****************************************************************
 
@@ -296,67 +532,75 @@ static VOID ConUnDirectJMP(ADDRINT ip, ADDRINT target, BOOL taken)
  *
  */
 
-static VOID UnconDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconDirectRet(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t1"                         // Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    retcount++;
+            << "\n";
+    td->ubcount++;
+    td->retcount++;
 }
 
-static VOID UnconUnDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconUnDirectRet(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t1"                         // Ret
             << "\t0"                         // Not Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    retcount++;
+            << "\n";
+    td->ubcount++;
+    td->retcount++;
 }
 
-static VOID ConDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConDirectRet(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t1"                         // Not Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    retcount++;
+            << "\n";
+    td->cbcount++;
+    td->retcount++;
 }
-static VOID ConUnDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConUnDirectRet(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Unconditional
             << "\t0"                         // Not Call
             << "\t1"                         // Not Ret
             << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    retcount++;
+            << "\n";
+    td->cbcount++;
+    td->retcount++;
 }
 //****************************************************************
 
@@ -365,73 +609,158 @@ static VOID ConUnDirectRet(ADDRINT ip, ADDRINT target, BOOL taken)
  * Call segment
  *
  */
-static VOID UnconDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconDirectCall(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t1"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    callcount++;
+            << "\n";
+    td->ubcount++;
+    td->callcount++;
 }
-static VOID UnconUnDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID UnconUnDirectCall(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t0"                         // Unconditional
             << "\t1"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    ubcount++;
-    callcount++;
+            << "\n";
+    td->ubcount++;
+    td->callcount++;
 }
-static VOID ConDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConDirectCall(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Unconditional
             << "\t1"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t1"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    callcount++;
+            << "\n";
+    td->cbcount++;
+    td->callcount++;
 }
-static VOID ConUnDirectCall(ADDRINT ip, ADDRINT target, BOOL taken)
+static VOID ConUnDirectCall(THREADID tid, ADDRINT ip, ADDRINT target, BOOL taken)
 {
-    OutFile << std::hex
-            << (ip & 0xffffffff)             // PC
-            << "\t" << (target & 0xffffffff) // Target
+    if (capture_done)
+        return;
+    thread_data_t *td = get_tls(tid);
+    td->OutFile << std::hex
+            << (ip & addr_mask)              // PC
+            << "\t" << (target & addr_mask)  // Target
             << (taken ? "\t1" : "\t0")       // T-N
             << "\t1"                         // Unconditional
             << "\t1"                         // Not Call
             << "\t0"                         // Not Ret
             << "\t0"                         // Direct
-            << "\n"
-            << flush;
-    cbcount++;
-    callcount++;
+            << "\n";
+    td->cbcount++;
+    td->callcount++;
 }
 //****************************************************************
 
+// Inserts the logging call matching the kind of the branch `ins`
+static VOID InstrumentBranch(INS ins)
+{
+    if (INS_HasFallThrough(ins) == false)
+    { // It is unconditional branch
+        if (INS_IsCall(ins))
+        { // It is call
+            if (INS_IsDirectControlFlow(ins) == true)
+            { // direct
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectCall, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectCall, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+        else if (INS_IsRet(ins))
+        { // It is RET
+            if (INS_IsDirectControlFlow(ins) == true)
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectRet, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectRet, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+        else
+        { // It is JMP
+            if (INS_IsDirectControlFlow(ins) == true)
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectJMP, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectJMP, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+    }
+    else
+    { // It is conditional branch
+        if (INS_IsCall(ins))
+        { // It is call
+            if (INS_IsDirectControlFlow(ins) == true)
+            { // direct
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectCall, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectCall, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+        else if (INS_IsRet(ins))
+        { // It is RET
+            if (INS_IsDirectControlFlow(ins) == true)
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectRet, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectRet, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+        else
+        { // It is JMP
+            if (INS_IsDirectControlFlow(ins) == true)
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectJMP, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+            else
+            {
+                INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectJMP, IARG_THREAD_ID, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
+            }
+        }
+    }
+}
+
 static VOID Instruction(INS ins, VOID *v)
 {
     // Insert a call to docount before every instruction, no arguments are passed
 
-    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount, IARG_END);
+    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)docount, IARG_THREAD_ID, IARG_END);
 
     if (record)
     {
@@ -439,81 +768,10 @@ static VOID Instruction(INS ins, VOID *v)
         {
             if (first_record)
             { // Detected the first branch
-                first_inst_count_after_offset = 1;
+                get_tls(PIN_ThreadId())->first_inst_count_after_offset = 1;
                 first_record = false;
             }
-            if (INS_HasFallThrough(ins) == false)
-            { // It is unconditional branch
-                if (INS_IsCall(ins))
-                { // It is call
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    { // direct
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else if (INS_IsRet(ins))
-                { // It is RET
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else
-                { // It is JMP
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)UnconUnDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-            }
-            else
-            { // It is conditional branch
-                if (INS_IsCall(ins))
-                { // It is call
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    { // direct
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectCall, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else if (INS_IsRet(ins))
-                { // It is RET
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectRet, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-                else
-                { // It is JMP
-                    if (INS_IsDirectControlFlow(ins) == true)
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                    else
-                    {
-                        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)ConUnDirectJMP, IARG_INST_PTR, IARG_BRANCH_TARGET_ADDR, IARG_BRANCH_TAKEN, IARG_END);
-                    }
-                }
-            }
+            InstrumentBranch(ins);
         }
     }
     // We do not care about instrunctions that are not branches.
@@ -521,6 +779,27 @@ static VOID Instruction(INS ins, VOID *v)
     //    INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)AtNonBranch, IARG_INST_PTR, IARG_END);
 }
 
+// Instrumentation of the sampling mode. Which code gets the logging calls is
+// decided when a trace is JITed, so every phase change flushes the code cache.
+static VOID SampleTrace(TRACE trace, VOID *v)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        if (!sample_active)
+        {
+            BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)GapCount, IARG_THREAD_ID, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+            continue;
+        }
+
+        BBL_InsertCall(bbl, IPOINT_BEFORE, (AFUNPTR)SampleCount, IARG_THREAD_ID, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+        for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins))
+        {
+            if (INS_IsValidForIpointTakenBranch(ins))
+                InstrumentBranch(ins);
+        }
+    }
+}
+
 /* ===================================================================== */
 /* Print Help Message                                                    */
 /* ===================================================================== */
@@ -535,21 +814,21 @@ INT32 Usage()
 
 INT32 InitFile()
 {
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << KnobOutputFile.Value() << "_" << fileCounter << ".out";
-    OutFile.open(filePrefix.str().c_str());
-    OutFile.setf(ios::showbase);
-
-    filePrefix.str("");
-    filePrefix.clear();
-    filePrefix << axuliryFileName << "_" << fileCounter << ".out";
-    axuFile.open(filePrefix.str().c_str());
-    axuFile.setf(ios::showbase);
+    // The per-thread output files are opened in ThreadStart
+    tls_key = PIN_CreateThreadDataKey(NULL);
+    PIN_InitLock(&threads_lock);
 
     howManyBranch = strtoull(KnobHowManyBranch.Value().c_str(), NULL, 0);
     howManySet = strtoull(KnobHowManySet.Value().c_str(), NULL, 0);
     offset_inst = strtoull(KnobOffset.Value().c_str(), NULL, 0);
+    CBCOUNT_LIMIT = strtoull(KnobLimit.Value().c_str(), NULL, 0);
+    detach_on_limit = strtoull(KnobDetach.Value().c_str(), NULL, 0) != 0 || PIN_IsAttaching();
+    if (strtoull(KnobAddressWidth.Value().c_str(), NULL, 0) == 64)
+        addr_mask = ~(ADDRINT)0;
+    sample_len = strtoull(KnobSampleLength.Value().c_str(), NULL, 0);
+    sample_period = strtoull(KnobSamplePeriod.Value().c_str(), NULL, 0);
+    fifo_logs = strtoull(KnobFifo.Value().c_str(), NULL, 0) != 0;
+    next_sample_start = offset_inst;
     cout << "My offset " << offset_inst << endl;
 
     cout << KnobHowManyBranch.Value() << endl;
@@ -564,11 +843,18 @@ int main(INT32 argc, CHAR **argv)
 
     InitFile();
 
-    INS_AddInstrumentFunction(Instruction, 0);
+    if (sample_len > 0)
+        TRACE_AddInstrumentFunction(SampleTrace, 0);
+    else
+        INS_AddInstrumentFunction(Instruction, 0);
     IMG_AddInstrumentFunction(ImageLoad, 0);
 
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    PIN_AddThreadFiniFunction(ThreadFini, 0);
+
     // Register Fini to be called when the application exits
     PIN_AddFiniFunction(Fini, 0);
+    PIN_AddDetachFunction(DetachFini, 0);
 
     PIN_StartProgram();
     return 0;
@@ -0,0 +1,64 @@
+#!/bin/bash
+# Sourced by gen_trace.sh and attach_trace.sh.
+#
+# With -z the tool creates every branch log (one per thread, and per sample
+# in sampling mode) as a named pipe, and opening one waits for a reader.
+# start_log_compressors gives each pipe its own compressor as soon as it
+# appears, so no log is written to disk uncompressed and all of them are
+# compressed while the program runs.
+
+# Pick the fastest bzip2-compatible compressor available; all of them
+# produce streams that `bunzip2 -kc` can read back.
+if command -v pbzip2 > /dev/null; then
+    COMPRESSOR="pbzip2 -c"
+elif command -v lbzip2 > /dev/null; then
+    COMPRESSOR="lbzip2 -c"
+else
+    COMPRESSOR="bzip2 -c"
+fi
+
+# log_suffix <log>
+#
+# Suffix of the trace files for branches<suffix>.out: none for the main
+# thread's first sample, _tN for thread N and _K for sample K.
+log_suffix()
+{
+    SUFFIX=${1##*/branches}
+    SUFFIX=${SUFFIX%.out}
+    case "${SUFFIX}" in
+        _0|_0_t*) SUFFIX=${SUFFIX#_0} ;;
+    esac
+    echo "${SUFFIX}"
+}
+
+# start_log_compressors <work dir> <trace name>
+#
+# Watches <work dir>, which the tool got as `-o <work dir>/branches`, in the
+# background until branches.done shows up there, and waits for the
+# compressors before exiting. Each log is compressed into
+# <trace name>$(log_suffix <log>).bz2. Sets LOG_COMPRESSORS_PID.
+start_log_compressors()
+{
+    (
+        declare -A STARTED
+        while true; do
+            # Checked first, so pipes created before the end are not missed
+            [ -e "$1/branches.done" ] && DONE=1
+            for LOG in "$1"/branches_*.out; do
+                [ -p "${LOG}" ] && [ -z "${STARTED[${LOG}]}" ] || continue
+                ${COMPRESSOR} < "${LOG}" > "$2$(log_suffix "${LOG}").bz2" &
+                STARTED[${LOG}]=1
+            done
+            [ -n "${DONE}" ] && break
+            sleep 0.1
+        done
+
+        # A compressor still waiting for a writer, if the tool died between
+        # creating a pipe and opening it, gets an empty stream
+        for LOG in "${!STARTED[@]}"; do
+            : <> "${LOG}"
+        done
+        wait
+    ) &
+    LOG_COMPRESSORS_PID=$!
+}
@@ -3,11 +3,24 @@ BRANCH_EXT_ROOT=$(dirname $(realpath -s $0))
 
 make -C ${BRANCH_EXT_ROOT}
 
-${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -- $1
+source ${BRANCH_EXT_ROOT}/compress_logs.sh
 
-mv branches_0.out $2
-mv generalInfo_0.out "$2.txt"
+# The tool writes every branch log into a named pipe that its own compressor
+# drains while the benchmark runs, so no uncompressed trace ever hits the
+# disk and compression finishes together with the benchmark.
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+start_log_compressors "${WORK_DIR}" "$2"
 
-echo "bzip2 in progress - it may take a while"
+${BRANCH_EXT_ROOT}/pin_tool/pin -t ${BRANCH_EXT_ROOT}/obj-intel64/branchExt.so -o "${WORK_DIR}/branches" -z 1 ${BRANCH_EXT_ARGS} -- $1
 
-bzip2 -f $2
\ No newline at end of file
+# The tool writes it too, unless pin failed before its Fini
+touch "${WORK_DIR}/branches.done"
+wait ${LOG_COMPRESSORS_PID}
+
+# Every thread, and every sample in sampling mode, has its own
+# generalInfo_<sample>[_t<tid>].out, named after its trace
+for LOG in "${WORK_DIR}"/branches_*.out; do
+    INFO="generalInfo${LOG#${WORK_DIR}/branches}"
+    [ -e "${INFO}" ] && mv "${INFO}" "$2$(log_suffix "${LOG}").txt"
+done
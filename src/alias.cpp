@@ -0,0 +1,86 @@
+//========================================================//
+//  alias.cpp                                             //
+//  Source file for the table aliasing instrumentation    //
+//                                                        //
+//  Only compiled in with `make ALIAS_STATS=1`            //
+//========================================================//
+#ifdef ALIAS_STATS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "alias.h"
+
+typedef struct
+{
+  const char *name;
+  uint64_t entries;
+  uint64_t *last_pc; // last PC + 1 to use each entry, 0 if never used
+  uint64_t touched;
+  uint64_t accesses;
+  uint64_t conflicts;
+  uint64_t constructive;
+  uint64_t destructive;
+} alias_table_t;
+
+static alias_table_t alias_tables[NUM_ALIAS_TABLES];
+
+void alias_register(int table, const char *name, uint64_t entries)
+{
+  alias_table_t *t = &alias_tables[table];
+  t->name = name;
+  t->entries = entries;
+  t->last_pc = (uint64_t *)calloc(entries, sizeof(uint64_t));
+}
+
+void alias_touch(int table, uint64_t index, uint64_t pc, int correct)
+{
+  alias_table_t *t = &alias_tables[table];
+  uint64_t *last = &t->last_pc[index];
+
+  t->accesses++;
+  if (*last == 0)
+  {
+    t->touched++;
+  }
+  else if (*last != pc + 1)
+  {
+    t->conflicts++;
+    if (correct)
+    {
+      t->constructive++;
+    }
+    else
+    {
+      t->destructive++;
+    }
+  }
+  *last = pc + 1;
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+void alias_report()
+{
+  printf("\nTable aliasing:\n");
+  printf("%-22s %8s %8s %12s %12s %9s %12s %12s\n", "Table", "Entries", "Used%",
+         "Accesses", "Conflicts", "Conflict%", "Constructive", "Destructive");
+  for (int i = 0; i < NUM_ALIAS_TABLES; i++)
+  {
+    alias_table_t *t = &alias_tables[i];
+    if (t->last_pc == NULL)
+    {
+      continue;
+    }
+    printf("%-22s %8" PRIu64 " %8.2f %12" PRIu64 " %12" PRIu64 " %9.3f %12" PRIu64 " %12" PRIu64 "\n",
+           t->name, t->entries, percent(t->touched, t->entries), t->accesses,
+           t->conflicts, percent(t->conflicts, t->accesses), t->constructive, t->destructive);
+    free(t->last_pc);
+    t->last_pc = NULL;
+  }
+}
+
+#endif
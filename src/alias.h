@@ -0,0 +1,58 @@
+//========================================================//
+//  alias.h                                               //
+//  Header file for the table aliasing instrumentation    //
+//                                                        //
+//  Built with `make ALIAS_STATS=1`. Otherwise the macros //
+//  below expand to nothing and cost nothing             //
+//========================================================//
+
+#ifndef ALIAS_H
+#define ALIAS_H
+
+#include <stdint.h>
+
+// Untagged predictor tables whose entries are shared between branches
+enum
+{
+  ALIAS_GSHARE,
+  ALIAS_TOURNAMENT_LOCAL_BHT,
+  ALIAS_TOURNAMENT_LOCAL_PHT,
+  ALIAS_TOURNAMENT_GLOBAL_PHT,
+  ALIAS_TOURNAMENT_CHOOSER,
+  ALIAS_PLT_PERCEPTRON,
+  ALIAS_PLT_LOCAL_BHT,
+  ALIAS_PLT_LOCAL_PHT,
+  ALIAS_PLT_CHOOSER,
+  NUM_ALIAS_TABLES
+};
+
+#ifdef ALIAS_STATS
+
+// Track table 'table' of 'entries' entries
+//
+void alias_register(int table, const char *name, uint64_t entries);
+
+// Branch 'pc' used entry 'index' of 'table', and the prediction read from
+// that entry was 'correct'. An access by another PC than the previous one
+// is a conflict; it is constructive if the shared entry still predicted
+// correctly and destructive otherwise.
+//
+void alias_touch(int table, uint64_t index, uint64_t pc, int correct);
+
+// Print occupancy and conflict statistics of every registered table
+//
+void alias_report();
+
+#define ALIAS_REGISTER(table, name, entries) alias_register(table, name, entries)
+#define ALIAS_TOUCH(table, index, pc, correct) alias_touch(table, index, pc, correct)
+#define ALIAS_REPORT() alias_report()
+
+#else
+
+#define ALIAS_REGISTER(table, name, entries)
+#define ALIAS_TOUCH(table, index, pc, correct)
+#define ALIAS_REPORT()
+
+#endif
+
+#endif
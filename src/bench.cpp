@@ -0,0 +1,408 @@
+//========================================================//
+//  bench.cpp                                             //
+//  Microbenchmarks of the predictor kernels              //
+//                                                        //
+//  Built and run with `make bench`. Times predict, train //
+//  and fused predict+train on synthetic in-memory branch //
+//  streams, and compares against a saved baseline        //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "predictor.h"
+#include "timing.h"
+
+// Predictor kernels of predictor.cpp, called directly so every predictor
+// can be measured, not just the ones reachable through bpType
+void init_bimodal();
+uint8_t bimodal_predict(uint64_t pc);
+void train_bimodal(uint64_t pc, uint8_t outcome);
+void cleanup_bimodal();
+void init_gshare();
+uint8_t gshare_predict(uint64_t pc);
+void train_gshare(uint64_t pc, uint8_t outcome);
+void cleanup_gshare();
+void init_tournament();
+uint8_t tournament_predict(uint64_t pc);
+void train_tournament(uint64_t pc, uint8_t outcome);
+void cleanup_tournament();
+void init_perceptron();
+uint8_t perceptron_predict(uint64_t pc);
+void train_perceptron(uint64_t pc, uint8_t outcome);
+void cleanup_perceptron();
+void init_plt();
+uint8_t plt_predict(uint64_t pc);
+void train_plt(uint64_t pc, uint8_t outcome);
+void cleanup_plt();
+
+typedef struct
+{
+  const char *name;
+  int bits; // ghistoryBits for gshare, 0 for the fixed-size predictors
+  void (*init)();
+  uint8_t (*predict)(uint64_t pc);
+  void (*train)(uint64_t pc, uint8_t outcome);
+  void (*cleanup)();
+} bench_kernel_t;
+
+// Only gshare has a run-time table size; the others are sized by consts
+// in predictor.cpp and are measured at those sizes.
+static bench_kernel_t kernels[] = {
+    {"bimodal", 0, init_bimodal, bimodal_predict, train_bimodal, cleanup_bimodal},
+    {"gshare", 13, init_gshare, gshare_predict, train_gshare, cleanup_gshare},
+    {"gshare", 17, init_gshare, gshare_predict, train_gshare, cleanup_gshare},
+    {"gshare", 21, init_gshare, gshare_predict, train_gshare, cleanup_gshare},
+    {"tournament", 0, init_tournament, tournament_predict, train_tournament, cleanup_tournament},
+    {"perceptron", 0, init_perceptron, perceptron_predict, train_perceptron, cleanup_perceptron},
+    {"plt", 0, init_plt, plt_predict, train_plt, cleanup_plt},
+};
+
+#define NUM_KERNELS (int)(sizeof(kernels) / sizeof(kernels[0]))
+
+enum
+{
+  OP_PREDICT,
+  OP_TRAIN,
+  OP_FUSED,
+  NUM_OPS
+};
+
+static const char *op_name[NUM_OPS] = {"predict", "train", "fused"};
+
+//------------------------------------//
+//     Synthetic branch streams       //
+//------------------------------------//
+
+#define STREAM_LENGTH (1 << 18)
+#define STREAM_BRANCHES 1024 // static branches per stream
+#define STREAM_BASE 0x400000
+
+typedef struct
+{
+  const char *name;
+  uint64_t pc[STREAM_LENGTH];
+  uint8_t outcome[STREAM_LENGTH];
+} bench_stream_t;
+
+enum
+{
+  STREAM_RANDOM,     // uniformly random outcomes
+  STREAM_BIASED,     // each branch taken 90% or 10% of the time
+  STREAM_LOOP,       // loop back edges with fixed trip counts
+  STREAM_CORRELATED, // outcomes that follow from the two previous ones
+  NUM_STREAMS
+};
+
+static bench_stream_t streams[NUM_STREAMS];
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t rng()
+{
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+static uint64_t branch_pc(uint64_t branch)
+{
+  return STREAM_BASE + 4 * branch;
+}
+
+static void make_streams()
+{
+  bench_stream_t *s;
+
+  s = &streams[STREAM_RANDOM];
+  s->name = "random";
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    s->pc[i] = branch_pc(rng() % STREAM_BRANCHES);
+    s->outcome[i] = rng() & 1;
+  }
+
+  s = &streams[STREAM_BIASED];
+  s->name = "biased";
+  for (int i = 0; i < STREAM_LENGTH; i++)
+  {
+    uint64_t branch = rng() % STREAM_BRANCHES;
+    int taken_often = branch & 1;
+    s->pc[i] = branch_pc(branch);
+    s->outcome[i] = (rng() % 10 != 0) == taken_often;
+  }
+
+  s = &streams[STREAM_LOOP];
+  s->name = "loop";
+  for (int i = 0; i < STREAM_LENGTH;)
+  {
+    uint64_t branch = rng() % STREAM_BRANCHES;
+    int trips = 2 + branch % 31;
+    for (int t = 0; t < trips && i < STREAM_LENGTH; t++, i++)
+    {
+      s->pc[i] = branch_pc(branch);
+      s->outcome[i] = t != trips - 1;
+    }
+  }
+
+  s = &streams[STREAM_CORRELATED];
+  s->name = "correlated";
+  for (int i = 0; i < STREAM_LENGTH; i += 3)
+  {
+    // Two random branches followed by one that is the XOR of both
+    uint64_t branch = 3 * (rng() % (STREAM_BRANCHES / 3));
+    uint8_t a = rng() & 1, b = rng() & 1;
+    for (int j = 0; j < 3 && i + j < STREAM_LENGTH; j++)
+    {
+      s->pc[i + j] = branch_pc(branch + j);
+    }
+    s->outcome[i] = a;
+    if (i + 1 < STREAM_LENGTH)
+    {
+      s->outcome[i + 1] = b;
+    }
+    if (i + 2 < STREAM_LENGTH)
+    {
+      s->outcome[i + 2] = a ^ b;
+    }
+  }
+}
+
+//------------------------------------//
+//           Measurement              //
+//------------------------------------//
+
+#define BENCH_REPEATS 5
+
+// Sink for the predictions so the predict loops are not optimized away
+static volatile uint32_t sink;
+
+static double run_once(bench_kernel_t *k, bench_stream_t *s, int op)
+{
+  if (k->bits)
+  {
+    ghistoryBits = k->bits;
+  }
+  k->init();
+
+  // Predict alone is measured on warmed-up tables
+  if (op == OP_PREDICT)
+  {
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      k->train(s->pc[i], s->outcome[i]);
+    }
+  }
+
+  uint32_t predicted = 0;
+  uint64_t start = timing_now();
+  switch (op)
+  {
+  case OP_PREDICT:
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      predicted += k->predict(s->pc[i]);
+    }
+    break;
+  case OP_TRAIN:
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      k->train(s->pc[i], s->outcome[i]);
+    }
+    break;
+  case OP_FUSED:
+    for (int i = 0; i < STREAM_LENGTH; i++)
+    {
+      predicted += k->predict(s->pc[i]) == s->outcome[i];
+      k->train(s->pc[i], s->outcome[i]);
+    }
+    break;
+  }
+  uint64_t elapsed = timing_now() - start;
+  sink = predicted;
+
+  k->cleanup();
+  return (double)elapsed / STREAM_LENGTH;
+}
+
+//------------------------------------//
+//             Baseline               //
+//------------------------------------//
+
+#define MAX_BASELINE 256
+
+typedef struct
+{
+  char key[64];
+  double ns;
+} baseline_entry_t;
+
+static baseline_entry_t baseline[MAX_BASELINE];
+static int baseline_size = 0;
+
+static void bench_key(char *key, size_t size, bench_kernel_t *k, bench_stream_t *s, int op)
+{
+  if (k->bits)
+  {
+    snprintf(key, size, "%s:%d/%s/%s", k->name, k->bits, s->name, op_name[op]);
+  }
+  else
+  {
+    snprintf(key, size, "%s/%s/%s", k->name, s->name, op_name[op]);
+  }
+}
+
+static int load_baseline(const char *path)
+{
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  char line[256];
+  while (fgets(line, sizeof(line), f) && baseline_size < MAX_BASELINE)
+  {
+    baseline_entry_t *e = &baseline[baseline_size];
+    if (line[0] != '#' && sscanf(line, "%63s %lf", e->key, &e->ns) == 2)
+    {
+      baseline_size++;
+    }
+  }
+  fclose(f);
+  return 1;
+}
+
+static double baseline_ns(const char *key)
+{
+  for (int i = 0; i < baseline_size; i++)
+  {
+    if (!strcmp(baseline[i].key, key))
+    {
+      return baseline[i].ns;
+    }
+  }
+  return 0.0;
+}
+
+//------------------------------------//
+//               Main                 //
+//------------------------------------//
+
+void usage()
+{
+  fprintf(stderr, "Usage: predictor_bench [--baseline=FILE] [--save=FILE] [--tolerance=PCT]\n");
+  fprintf(stderr, " --baseline=FILE  Compare against the ns/op saved in FILE\n");
+  fprintf(stderr, " --save=FILE      Save this run's ns/op as a new baseline\n");
+  fprintf(stderr, " --tolerance=PCT  Slowdown reported as a regression (default 25)\n");
+}
+
+int main(int argc, char *argv[])
+{
+  const char *baseline_path = NULL;
+  const char *save_path = NULL;
+  double tolerance = 25.0;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strncmp(argv[i], "--baseline=", 11))
+    {
+      baseline_path = argv[i] + 11;
+    }
+    else if (!strncmp(argv[i], "--save=", 7))
+    {
+      save_path = argv[i] + 7;
+    }
+    else if (!strncmp(argv[i], "--tolerance=", 12))
+    {
+      tolerance = atof(argv[i] + 12);
+    }
+    else
+    {
+      usage();
+      exit(!!strcmp(argv[i], "--help"));
+    }
+  }
+
+  if (baseline_path && !load_baseline(baseline_path))
+  {
+    fprintf(stderr, "No baseline %s, nothing to compare against\n", baseline_path);
+  }
+  FILE *save = NULL;
+  if (save_path)
+  {
+    save = fopen(save_path, "w");
+    if (save == NULL)
+    {
+      fprintf(stderr, "Unable to open %s\n", save_path);
+      exit(1);
+    }
+    fprintf(save, "# ns/op of `make bench`, best of %d runs over %d branches\n",
+            BENCH_REPEATS, STREAM_LENGTH);
+  }
+
+  make_streams();
+
+  // Runs are compared on their best time, which is the least disturbed by
+  // the rest of the machine; the mean and spread are shown alongside.
+  printf("%-34s %9s %8s %9s %10s %10s\n", "Benchmark", "ns/op", "Stddev%", "Best", "Mops/s", "Baseline%");
+  int regressions = 0;
+  for (int k = 0; k < NUM_KERNELS; k++)
+  {
+    for (int s = 0; s < NUM_STREAMS; s++)
+    {
+      for (int op = 0; op < NUM_OPS; op++)
+      {
+        double sum = 0.0, sum_sq = 0.0, best = 0.0;
+        for (int r = 0; r < BENCH_REPEATS; r++)
+        {
+          double ns = run_once(&kernels[k], &streams[s], op);
+          sum += ns;
+          sum_sq += ns * ns;
+          if (r == 0 || ns < best)
+          {
+            best = ns;
+          }
+        }
+        double mean = sum / BENCH_REPEATS;
+        double var = sum_sq / BENCH_REPEATS - mean * mean;
+        double stddev = var > 0.0 ? sqrt(var) : 0.0;
+
+        char key[64];
+        bench_key(key, sizeof(key), &kernels[k], &streams[s], op);
+        printf("%-34s %9.2f %8.2f %9.2f %10.2f", key, mean, 100.0 * stddev / mean, best, 1000.0 / mean);
+
+        double base = baseline_ns(key);
+        if (base > 0.0)
+        {
+          double change = 100.0 * (best - base) / base;
+          printf(" %+10.1f", change);
+          if (change > tolerance)
+          {
+            printf("  REGRESSION");
+            regressions++;
+          }
+        }
+        printf("\n");
+
+        if (save)
+        {
+          fprintf(save, "%s %.3f\n", key, best);
+        }
+      }
+    }
+  }
+
+  if (save)
+  {
+    fclose(save);
+  }
+  if (baseline_size)
+  {
+    printf("%d regression(s) beyond %.0f%% of %s\n", regressions, tolerance, baseline_path);
+  }
+
+  return regressions ? 1 : 0;
+}
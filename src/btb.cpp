@@ -0,0 +1,187 @@
+//========================================================//
+//  btb.cpp                                               //
+//  Source file for the branch target buffer model        //
+//                                                        //
+//  Enabled with --btb, see main.cpp                      //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "predictor.h"
+#include "btb.h"
+
+static const char *policy_name[NUM_BTB_POLICIES] = {"lru", "fifo", "random"};
+
+// 1024 sets x 4 ways with 16-bit tags, replaced LRU
+btb_t btb = {{1024, 4, 16, BTB_LRU}, NULL, {0, 0}, {0, 0, 0, 0, 0, 0, 0}};
+
+static int set_bits;
+
+static uint64_t rng()
+{
+  btb.regs.rng ^= btb.regs.rng << 13;
+  btb.regs.rng ^= btb.regs.rng >> 7;
+  btb.regs.rng ^= btb.regs.rng << 17;
+  return btb.regs.rng;
+}
+
+int btb_config(const char *spec)
+{
+  char policy[16] = "";
+  int n = sscanf(spec, "%d:%d:%d:%15s", &btb.config.sets, &btb.config.ways, &btb.config.tag_bits, policy);
+  if (n < 1 || btb.config.sets <= 0 || (btb.config.sets & (btb.config.sets - 1)) || btb.config.ways <= 0 ||
+      btb.config.tag_bits < 0 || btb.config.tag_bits > 64)
+  {
+    return 0;
+  }
+  if (n == 4)
+  {
+    for (btb.config.policy = 0; btb.config.policy < NUM_BTB_POLICIES; btb.config.policy++)
+    {
+      if (!strcmp(policy, policy_name[btb.config.policy]))
+      {
+        break;
+      }
+    }
+    return btb.config.policy < NUM_BTB_POLICIES;
+  }
+  return 1;
+}
+
+void btb_init()
+{
+  for (set_bits = 0; (1 << set_bits) < btb.config.sets; set_bits++)
+    ;
+  btb.entries = (btb_entry_t *)calloc((size_t)btb.config.sets * btb.config.ways, sizeof(btb_entry_t));
+  btb.regs.clock = 0;
+  btb.regs.rng = 0x9e3779b97f4a7c15ULL;
+  memset(&btb.stats, 0, sizeof(btb.stats));
+}
+
+// Partial tags let branches of the same set alias each other
+static uint64_t btb_tag(uint64_t pc)
+{
+  uint64_t tag = pc >> set_bits;
+  return btb.config.tag_bits && btb.config.tag_bits < 64 ? tag & ((1ULL << btb.config.tag_bits) - 1) : tag;
+}
+
+static btb_entry_t *btb_find(uint64_t pc)
+{
+  btb_entry_t *set = &btb.entries[(pc & (btb.config.sets - 1)) * btb.config.ways];
+  uint64_t tag = btb_tag(pc);
+  for (int w = 0; w < btb.config.ways; w++)
+  {
+    if (set[w].stamp && set[w].tag == tag)
+    {
+      return &set[w];
+    }
+  }
+  return NULL;
+}
+
+void btb_score(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t prediction,
+               int target_correct)
+{
+  btb_entry_t *e = btb_find(pc);
+  btb.stats.lookups++;
+  btb.stats.conditional += condition;
+  if (e)
+  {
+    btb.stats.hits++;
+    if (btb.config.policy == BTB_LRU)
+    {
+      e->stamp = ++btb.regs.clock;
+    }
+  }
+
+  // Without a hit fetch just falls through, right or not
+  int redirect = e && (!condition || prediction == TAKEN);
+  int correct;
+  if (outcome)
+  {
+    btb.stats.taken++;
+    if (e == NULL)
+    {
+      btb.stats.taken_misses++;
+    }
+    else if (e->target != target)
+    {
+      btb.stats.wrong_targets++;
+    }
+    correct = redirect && (target_correct >= 0 ? target_correct : e->target == target);
+  }
+  else
+  {
+    correct = !redirect;
+  }
+  if (!correct)
+  {
+    btb.stats.mispredictions++;
+  }
+}
+
+void btb_update(uint64_t pc, uint64_t target)
+{
+  btb_entry_t *e = btb_find(pc);
+  if (e == NULL)
+  {
+    // Fill an empty way, or evict the oldest (or a random) one
+    btb_entry_t *set = &btb.entries[(pc & (btb.config.sets - 1)) * btb.config.ways];
+    e = &set[btb.config.policy == BTB_RANDOM ? rng() % btb.config.ways : 0];
+    for (int w = 0; w < btb.config.ways; w++)
+    {
+      if (set[w].stamp == 0)
+      {
+        e = &set[w];
+        break;
+      }
+      if (btb.config.policy != BTB_RANDOM && set[w].stamp < e->stamp)
+      {
+        e = &set[w];
+      }
+    }
+    e->tag = btb_tag(pc);
+    e->stamp = ++btb.regs.clock;
+  }
+  else if (btb.config.policy == BTB_LRU)
+  {
+    e->stamp = ++btb.regs.clock;
+  }
+  e->target = target;
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+void btb_report()
+{
+  btb_stats_t *st = &btb.stats;
+  printf("\nBTB (%d sets x %d ways, ", btb.config.sets, btb.config.ways);
+  if (btb.config.tag_bits)
+  {
+    printf("%d-bit tags, %s):\n", btb.config.tag_bits, policy_name[btb.config.policy]);
+  }
+  else
+  {
+    printf("full tags, %s):\n", policy_name[btb.config.policy]);
+  }
+  printf("  Lookups:         %10" PRIu64 "\n", st->lookups);
+  printf("  Hits:            %10" PRIu64 "  %6.2f%%\n", st->hits, percent(st->hits, st->lookups));
+  printf("  Misses:          %10" PRIu64 "  %6.2f%%\n", st->lookups - st->hits,
+         percent(st->lookups - st->hits, st->lookups));
+  printf("  Taken:           %10" PRIu64 "\n", st->taken);
+  printf("  Taken misses:    %10" PRIu64 "  %6.2f%%\n", st->taken_misses, percent(st->taken_misses, st->taken));
+  printf("  Wrong targets:   %10" PRIu64 "  %6.2f%%\n", st->wrong_targets, percent(st->wrong_targets, st->taken));
+  printf("  Direction+target mispredictions: %" PRIu64 " (%.3f per 1000 branches, %.3f per 1000 conditional)\n",
+         st->mispredictions, 1000.0 * st->mispredictions / (st->lookups ? st->lookups : 1),
+         1000.0 * st->mispredictions / (st->conditional ? st->conditional : 1));
+}
+
+void btb_cleanup()
+{
+  free(btb.entries);
+  btb.entries = NULL;
+}
@@ -0,0 +1,98 @@
+//========================================================//
+//  btb.h                                                 //
+//  Header file for the branch target buffer model        //
+//                                                        //
+//  A set-associative BTB of taken branch targets, scored //
+//  together with the direction predictor as the front    //
+//  end would use them                                    //
+//========================================================//
+
+#ifndef BTB_H
+#define BTB_H
+
+#include <stdint.h>
+
+// Replacement policies
+enum
+{
+  BTB_LRU,
+  BTB_FIFO,
+  BTB_RANDOM,
+  NUM_BTB_POLICIES
+};
+
+typedef struct
+{
+  uint64_t tag;
+  uint64_t target;
+  uint64_t stamp; // last use (LRU) or insertion (FIFO), 0 for an empty way
+} btb_entry_t;
+
+typedef struct
+{
+  uint64_t lookups;         // branch records looked up, conditional or not
+  uint64_t conditional;     // ... of which conditional
+  uint64_t hits;
+  uint64_t taken;           // taken branches among the lookups
+  uint64_t taken_misses;    // ... not in the BTB
+  uint64_t wrong_targets;   // ... in it, with a stale or aliased target
+  uint64_t mispredictions;  // fetch redirects wrong in direction or target
+} btb_stats_t;
+
+// Shape of the BTB. Saved in snapshots, which only load into a BTB
+// configured the same way.
+typedef struct
+{
+  int32_t sets;     // power of two
+  int32_t ways;
+  int32_t tag_bits; // 0 for full tags
+  int32_t policy;
+} btb_config_t;
+
+// Replacement state, saved in snapshots with the entries
+typedef struct
+{
+  uint64_t clock; // stamp of the last use or insertion
+  uint64_t rng;   // state of the BTB_RANDOM generator
+} btb_regs_t;
+
+typedef struct
+{
+  btb_config_t config;
+  btb_entry_t *entries; // sets * ways, NULL when the BTB is off
+  btb_regs_t regs;
+  btb_stats_t stats;
+} btb_t;
+
+extern btb_t btb;
+
+// Parse a --btb configuration SETS:WAYS:TAGBITS:POLICY, any suffix of
+// which may be left out. Returns 0 if it is malformed.
+//
+int btb_config(const char *spec);
+
+// Allocate the configured BTB, empty
+//
+void btb_init();
+
+// Score the fetch redirect for the branch record at 'pc': the BTB is
+// looked up and, if it hits and the direction predictor said 'prediction'
+// TAKEN (always, for unconditional branches), fetch goes to its target.
+// For a return or indirect branch whose target comes from the RAS or the
+// indirect predictor instead, 'target_correct' is whether that was right;
+// it is -1 for every other branch.
+//
+void btb_score(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t prediction,
+               int target_correct);
+
+// Insert or refresh the target of the taken branch at 'pc'
+//
+void btb_update(uint64_t pc, uint64_t target);
+
+// Print the BTB statistics gathered since btb_init
+//
+void btb_report();
+
+void btb_cleanup();
+
+#endif
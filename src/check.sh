@@ -0,0 +1,93 @@
+#!/bin/bash
+# Regression gate of the simulator: runs every predictor on every bundled
+# trace and fails if a Branches/Incorrect count differs from
+# check_golden.txt, or if the best branches/sec of RUNS runs (default 3)
+# fell more than TOLERANCE percent (default 25) below check_baseline.txt.
+# The baseline is only meaningful on the machine that recorded it, so it is
+# not part of the repository: the first run records it.
+#
+#   ./check.sh                  check against the golden counts and the
+#                               throughput baseline
+#   ./check.sh --save-baseline  record this machine's throughput as baseline
+#   ./check.sh --save-golden    record new golden counts, for changes that
+#                               are meant to change the predictions
+SRC_ROOT=$(dirname $(realpath -s $0))
+TRACE_DIR=${TRACE_DIR:-${SRC_ROOT}/../traces}
+GOLDEN=${SRC_ROOT}/check_golden.txt
+BASELINE=${SRC_ROOT}/check_baseline.txt
+TOLERANCE=${TOLERANCE:-25}
+RUNS=${RUNS:-3}
+MODE=$1
+
+TIMED_RUNS=${RUNS}
+if [ "${MODE}" == "--save-golden" ]; then
+    TIMED_RUNS=1
+elif [ -z "${MODE}" ] && [ ! -f "${BASELINE}" ]; then
+    echo "No ${BASELINE} yet, this run records it"
+    MODE=--save-baseline
+fi
+
+WORK_DIR=$(mktemp -d)
+trap 'rm -rf "${WORK_DIR}"' EXIT
+
+FAILED=0
+printf "%-10s %-11s %10s %10s %12s %10s  %s\n" Trace Predictor Branches Incorrect Branches/sec Baseline% Result
+
+# Each trace is decompressed once and shared by all the predictors, so the
+# throughput is that of the simulator and not of bunzip2
+for TRACE in $(awk '!/^#/ { print $1 }' "${GOLDEN}" | uniq); do
+    if [ ! -f "${TRACE_DIR}/${TRACE}.bz2" ]; then
+        echo "${TRACE}: no ${TRACE}.bz2 in ${TRACE_DIR}, skipped"
+        continue
+    fi
+    bunzip2 -kc "${TRACE_DIR}/${TRACE}.bz2" > "${WORK_DIR}/trace"
+
+    for PREDICTOR in $(awk -v t="${TRACE}" '$1 == t { print $2 }' "${GOLDEN}"); do
+        # The best of several runs is the least disturbed by the rest of
+        # the machine
+        RATE=0
+        for RUN in $(seq ${TIMED_RUNS}); do
+            OUTPUT=$(${SRC_ROOT}/predictor --${PREDICTOR} --timing "${WORK_DIR}/trace")
+            RUN_RATE=$(awk '/Branches\/sec:/ { print $2 }' <<< "${OUTPUT}")
+            RATE=$(awk -v a="${RATE}" -v b="${RUN_RATE}" 'BEGIN { print (b > a ? b : a) }')
+        done
+        BRANCHES=$(awk '/^Branches:/ { print $2 }' <<< "${OUTPUT}")
+        INCORRECT=$(awk '/^Incorrect:/ { print $2 }' <<< "${OUTPUT}")
+        echo "${TRACE} ${PREDICTOR} ${BRANCHES} ${INCORRECT}" >> "${WORK_DIR}/golden"
+        echo "${TRACE} ${PREDICTOR} ${RATE}" >> "${WORK_DIR}/baseline"
+
+        RESULT=ok
+        EXPECTED=$(awk -v t="${TRACE}" -v p="${PREDICTOR}" '$1 == t && $2 == p { print $3, $4 }' "${GOLDEN}")
+        if [ "${MODE}" != "--save-golden" ] && [ "${EXPECTED}" != "${BRANCHES} ${INCORRECT}" ]; then
+            RESULT="FAIL: expected ${EXPECTED}"
+            FAILED=1
+        fi
+
+        CHANGE=-
+        BASE=$(awk -v t="${TRACE}" -v p="${PREDICTOR}" '$1 == t && $2 == p { print $3 }' "${BASELINE}" 2> /dev/null)
+        if [ -z "${MODE}" ] && [ -n "${BASE}" ]; then
+            CHANGE=$(awk -v r="${RATE}" -v b="${BASE}" 'BEGIN { printf "%+.1f", 100 * (r - b) / b }')
+            if awk -v c="${CHANGE}" -v t="${TOLERANCE}" 'BEGIN { exit !(c < -t) }'; then
+                RESULT="${RESULT}, SLOWER than baseline"
+                FAILED=1
+            fi
+        fi
+
+        printf "%-10s %-11s %10s %10s %12s %10s  %s\n" "${TRACE}" "${PREDICTOR}" "${BRANCHES}" "${INCORRECT}" "${RATE}" "${CHANGE}" "${RESULT}"
+    done
+done
+
+if [ "${MODE}" == "--save-golden" ]; then
+    (grep '^#' "${GOLDEN}"; cat "${WORK_DIR}/golden") > "${WORK_DIR}/golden.new"
+    mv "${WORK_DIR}/golden.new" "${GOLDEN}"
+    echo "Saved ${GOLDEN}"
+elif [ "${MODE}" == "--save-baseline" ] && [ ${FAILED} -eq 0 ]; then
+    (echo "# trace predictor branches/sec, best of ${RUNS} runs, recorded by ./check.sh"; cat "${WORK_DIR}/baseline") > "${BASELINE}"
+    echo "Saved ${BASELINE}"
+fi
+
+if [ ${FAILED} -ne 0 ]; then
+    echo "check FAILED"
+    exit 1
+fi
+echo "check passed"
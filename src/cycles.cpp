@@ -0,0 +1,77 @@
+//========================================================//
+//  cycles.cpp                                            //
+//  Source file for the misprediction timing model        //
+//                                                        //
+//  Enabled with --cycles, see main.cpp                   //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include "cycles.h"
+
+cycles_model_t cycles_model = {0, CYCLES_DEFAULT_PENALTY, CYCLES_DEFAULT_IPC};
+
+int cycles_side_instructions(const char *trace_path, uint64_t *instructions)
+{
+  static const char *suffixes[] = {".bz2", ".bpt", ".txt"};
+
+  char path[4096];
+  snprintf(path, sizeof(path) - 4, "%s", trace_path);
+  size_t len = strlen(path);
+  for (int i = 0; i < 3; i++)
+  {
+    size_t n = strlen(suffixes[i]);
+    if (len > n && !strcmp(path + len - n, suffixes[i]))
+    {
+      path[len - n] = '\0';
+      break;
+    }
+  }
+  strcat(path, ".txt");
+  // A decompressed trace named like its side file is not one
+  if (!strcmp(path, trace_path))
+  {
+    return 0;
+  }
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  char line[256];
+  int found = 0;
+  while (!found && fgets(line, sizeof(line), f))
+  {
+    found = sscanf(line, "!!! Number of Instructions = %" SCNu64, instructions) == 1;
+  }
+  fclose(f);
+  return found;
+}
+
+static double cycles_of(uint64_t mispredictions)
+{
+  return cycles_model.instructions / cycles_model.ipc + (double)mispredictions * cycles_model.penalty;
+}
+
+void cycles_report(uint64_t num_branches, uint64_t mispredictions, int64_t static_mispredictions)
+{
+  double insts = (double)cycles_model.instructions;
+  double base = cycles_of(0);
+  double cycles = cycles_of(mispredictions);
+
+  printf("\nTiming model (%" PRIu64 " instructions, base IPC %.2f, %d-cycle penalty):\n",
+         cycles_model.instructions, cycles_model.ipc, cycles_model.penalty);
+  printf("  MPKI:              %10.3f\n", 1000.0 * mispredictions / insts);
+  printf("  Branches per KI:   %10.3f\n", 1000.0 * num_branches / insts);
+  printf("  Cycles:            %10.0f\n", cycles);
+  printf("  Cycles lost:       %10.0f  %6.2f%%\n", cycles - base, 100.0 * (cycles - base) / cycles);
+  printf("  IPC:               %10.3f\n", insts / cycles);
+  if (static_mispredictions >= 0)
+  {
+    double static_cycles = cycles_of(static_mispredictions);
+    printf("  Speedup over static:  %7.3fx  (static MPKI %.3f, IPC %.3f)\n", static_cycles / cycles,
+           1000.0 * static_mispredictions / insts, insts / static_cycles);
+  }
+  printf("  Perfect prediction:   %7.3fx faster\n", cycles / base);
+}
@@ -0,0 +1,40 @@
+//========================================================//
+//  cycles.h                                              //
+//  Header file for the misprediction timing model        //
+//                                                        //
+//  Turns misprediction counts into MPKI and cycles lost, //
+//  given the instruction count of the trace, a pipeline  //
+//  refill penalty and the IPC without mispredictions     //
+//========================================================//
+
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdint.h>
+
+#define CYCLES_DEFAULT_PENALTY 20
+#define CYCLES_DEFAULT_IPC 2.0
+
+typedef struct
+{
+  uint64_t instructions; // of the whole trace, 0 while unknown
+  int penalty;           // cycles lost per misprediction
+  double ipc;            // instructions per cycle with perfect prediction
+} cycles_model_t;
+
+extern cycles_model_t cycles_model;
+
+// Read the instruction count of a trace from the side file branchExt
+// writes next to it ("x264.txt" for "x264.bz2" or "x264.bpt"). Returns 0
+// if there is no such file or it has no count.
+//
+int cycles_side_instructions(const char *trace_path, uint64_t *instructions);
+
+// Print the timing of a run of 'num_branches' conditional branches with
+// 'mispredictions', next to those of static prediction (always taken,
+// 'static_mispredictions', or none if it is unknown) and of perfect
+// prediction
+//
+void cycles_report(uint64_t num_branches, uint64_t mispredictions, int64_t static_mispredictions);
+
+#endif
@@ -0,0 +1,53 @@
+//========================================================//
+//  delay.cpp                                             //
+//  Source file for the delayed update model              //
+//                                                        //
+//  Enabled with --update-delay, see main.cpp             //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "delay.h"
+
+delay_t delay;
+
+void delay_init()
+{
+  memset(&delay, 0, sizeof(delay));
+  delay.ring = (pending_update_t *)calloc(update_delay, sizeof(pending_update_t));
+}
+
+void delay_branch(uint64_t pc, uint32_t outcome)
+{
+  pending_update_t *p = &delay.ring[delay.next % update_delay];
+
+  // The slot holds the update that has now waited long enough
+  if (delay.next >= (uint64_t)update_delay)
+  {
+    train_predictor_delayed(p->pc, p->outcome, &p->history);
+    delay.applied++;
+  }
+
+  p->pc = pc;
+  p->outcome = outcome;
+  predictor_history_save(pc, &p->history);
+
+  // The branch resolves before the next one is predicted, so only the
+  // table update waits
+  predictor_history_update(pc, outcome);
+  delay.next++;
+}
+
+void delay_report()
+{
+  printf("\nUpdate delay of %d conditional branches:\n", update_delay);
+  printf("  Table updates applied:       %10" PRIu64 "\n", delay.applied);
+  printf("  Table updates still pending: %10" PRIu64 "\n", delay.next - delay.applied);
+}
+
+void delay_cleanup()
+{
+  free(delay.ring);
+  delay.ring = NULL;
+}
@@ -0,0 +1,52 @@
+//========================================================//
+//  delay.h                                               //
+//  Header file for the delayed update model              //
+//                                                        //
+//  Queues the direction table updates of conditional     //
+//  branches in a ring and applies each one N conditional //
+//  branches after its prediction. Histories take the     //
+//  outcome right away, as if every branch resolved       //
+//  before the next one is predicted                      //
+//========================================================//
+
+#ifndef DELAY_H
+#define DELAY_H
+
+#include <stdint.h>
+#include "predictor.h"
+
+// A table update waiting in the pipeline
+typedef struct
+{
+  uint64_t pc;
+  uint32_t outcome;
+  history_snapshot_t history; // at prediction time, for the table update
+} pending_update_t;
+
+typedef struct
+{
+  pending_update_t *ring; // update_delay entries
+  uint64_t next;          // branches queued so far, the oldest pending
+                          // one is at next % update_delay once full
+  uint64_t applied;       // table updates applied
+} delay_t;
+
+extern delay_t delay;
+
+// Allocate an empty ring of update_delay pending updates
+//
+void delay_init();
+
+// Handle the conditional branch at 'pc', just predicted: apply the table
+// update that has waited update_delay branches, queue this one's, and
+// shift its outcome into the histories
+//
+void delay_branch(uint64_t pc, uint32_t outcome);
+
+// Print the number of table updates applied and still pending
+//
+void delay_report();
+
+void delay_cleanup();
+
+#endif
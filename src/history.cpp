@@ -0,0 +1,69 @@
+//========================================================//
+//  history.cpp                                           //
+//  Source file for the shared global and path history    //
+//                                                        //
+//  Updated by train_predictor64, see predictor.cpp       //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "history.h"
+
+global_history_t global_history;
+
+void history_init()
+{
+  memset(&global_history, 0, sizeof(global_history));
+}
+
+int history_fold(int length, int width)
+{
+  // The tables that fold the history are fixed at compile time, so this
+  // is a configuration error
+  if (global_history.num_folded == MAX_FOLDED_HISTORIES || length > HISTORY_MAX_LENGTH || width < 1 ||
+      width > 31)
+  {
+    fprintf(stderr, "Cannot fold %d history bits into %d: at most %d folded histories of up to %d bits\n",
+            length, width, MAX_FOLDED_HISTORIES, HISTORY_MAX_LENGTH);
+    exit(1);
+  }
+  folded_history_t *f = &global_history.folded[global_history.num_folded];
+  f->value = 0;
+  f->length = length;
+  f->width = width;
+  return global_history.num_folded++;
+}
+
+static void history_push(int bit)
+{
+  global_history_t *h = &global_history;
+  h->pos++;
+  h->bits[h->pos & (HISTORY_BUFFER_SIZE - 1)] = bit;
+
+  // Shift the new bit in and cancel the one leaving each folded window
+  for (int i = 0; i < h->num_folded; i++)
+  {
+    folded_history_t *f = &h->folded[i];
+    uint32_t v = (f->value << 1) | bit;
+    v ^= (uint32_t)history_bit(f->length) << (f->length % f->width);
+    v ^= v >> f->width;
+    f->value = v & ((1u << f->width) - 1);
+  }
+}
+
+void history_update(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t ret,
+                    uint32_t direct)
+{
+  if (condition)
+  {
+    history_push(outcome);
+  }
+  else if (!direct && !ret)
+  {
+    history_push((target ^ (target >> 3)) & 1);
+  }
+  if (outcome)
+  {
+    global_history.path = (global_history.path << 1) | ((pc ^ (pc >> 2)) & 1);
+  }
+}
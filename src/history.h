@@ -0,0 +1,71 @@
+//========================================================//
+//  history.h                                             //
+//  Header file for the shared global and path history    //
+//                                                        //
+//  One long global history, updated once per branch by   //
+//  train_predictor64, that any number of tables can read //
+//  through folded (compressed) copies. Only ITTAGE reads //
+//  it: gshare, tournament and custom keep the histories  //
+//  their results were tuned with                         //
+//========================================================//
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdint.h>
+
+// Longest history a table can fold; the buffer is a power of two above it
+#define HISTORY_MAX_LENGTH 1024
+#define HISTORY_BUFFER_SIZE 2048
+
+#define MAX_FOLDED_HISTORIES 32
+
+// The last 'length' history bits XOR-folded down to 'width' bits, kept
+// up to date incrementally as bits are pushed
+typedef struct
+{
+  uint32_t value;
+  int length;
+  int width;
+} folded_history_t;
+
+typedef struct
+{
+  uint8_t bits[HISTORY_BUFFER_SIZE]; // one bit per byte, circular
+  uint64_t pos;                      // index of the newest bit
+  uint64_t path;                     // low address bits of recent taken branches
+  folded_history_t folded[MAX_FOLDED_HISTORIES];
+  int num_folded;
+} global_history_t;
+
+extern global_history_t global_history;
+
+// Empty the history and drop every folded copy
+//
+void history_init();
+
+// Keep a folded copy of the last 'length' bits in 'width' bits. Returns
+// its id for history_folded. Exits if MAX_FOLDED_HISTORIES are already
+// kept, or 'length' or 'width' is out of range.
+//
+int history_fold(int length, int width);
+
+static inline uint32_t history_folded(int id)
+{
+  return global_history.folded[id].value;
+}
+
+// Bit 'age' of the history, 0 being the newest
+//
+static inline int history_bit(int age)
+{
+  return global_history.bits[(global_history.pos - age) & (HISTORY_BUFFER_SIZE - 1)];
+}
+
+// Record the branch at 'pc': conditional branches push their outcome,
+// indirect ones a bit of their target, and taken ones shift the path
+//
+void history_update(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t ret,
+                    uint32_t direct);
+
+#endif
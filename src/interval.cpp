@@ -0,0 +1,126 @@
+//========================================================//
+//  interval.cpp                                          //
+//  Source file for the interval statistics stream        //
+//                                                        //
+//  Enabled with --interval, see main.cpp                 //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "interval.h"
+
+// Records queued between the simulation loop and the writer thread. The
+// loop only takes the lock to publish a record, never while the file is
+// being written, so it waits only if the writer falls a full ring behind.
+#define INTERVAL_RING_SIZE 4096
+
+static interval_record_t ring[INTERVAL_RING_SIZE];
+static uint64_t ring_head = 0; // next record to publish
+static uint64_t ring_tail = 0; // next record to write out
+static int ring_closed = 0;
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_not_full = PTHREAD_COND_INITIALIZER;
+
+static FILE *interval_file;
+static pthread_t writer;
+
+static uint64_t last_branches = 0;
+static uint64_t last_mispredictions = 0;
+static uint64_t next_index = 0;
+
+static double rate(uint64_t mispredictions, uint64_t branches)
+{
+  return branches ? 1000.0 * mispredictions / branches : 0.0;
+}
+
+static void *interval_writer(void *)
+{
+  interval_record_t batch[INTERVAL_RING_SIZE];
+
+  for (;;)
+  {
+    pthread_mutex_lock(&ring_lock);
+    while (ring_tail == ring_head && !ring_closed)
+    {
+      pthread_cond_wait(&ring_not_empty, &ring_lock);
+    }
+    uint64_t n = ring_head - ring_tail;
+    for (uint64_t i = 0; i < n; i++)
+    {
+      batch[i] = ring[(ring_tail + i) % INTERVAL_RING_SIZE];
+    }
+    ring_tail = ring_head;
+    int done = ring_closed;
+    pthread_cond_signal(&ring_not_full);
+    pthread_mutex_unlock(&ring_lock);
+
+    for (uint64_t i = 0; i < n; i++)
+    {
+      interval_record_t *r = &batch[i];
+      fprintf(interval_file, "%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%.3f,%" PRIu64 ",%" PRIu64 ",%.3f\n",
+              r->index, r->branches, r->mispredictions, rate(r->mispredictions, r->branches),
+              r->interval_branches, r->interval_mispredictions,
+              rate(r->interval_mispredictions, r->interval_branches));
+    }
+
+    if (done)
+    {
+      return NULL;
+    }
+  }
+}
+
+int interval_open(const char *path)
+{
+  interval_file = strcmp(path, "-") ? fopen(path, "w") : stdout;
+  if (interval_file == NULL)
+  {
+    return 0;
+  }
+  fprintf(interval_file, "interval,branches,mispredictions,rate,"
+                         "interval_branches,interval_mispredictions,interval_rate\n");
+
+  return pthread_create(&writer, NULL, interval_writer, NULL) == 0;
+}
+
+void interval_emit(uint64_t branches, uint64_t mispredictions)
+{
+  interval_record_t r;
+  r.index = next_index++;
+  r.branches = branches;
+  r.mispredictions = mispredictions;
+  r.interval_branches = branches - last_branches;
+  r.interval_mispredictions = mispredictions - last_mispredictions;
+  last_branches = branches;
+  last_mispredictions = mispredictions;
+
+  pthread_mutex_lock(&ring_lock);
+  while (ring_head - ring_tail == INTERVAL_RING_SIZE)
+  {
+    pthread_cond_wait(&ring_not_full, &ring_lock);
+  }
+  ring[ring_head % INTERVAL_RING_SIZE] = r;
+  ring_head++;
+  pthread_cond_signal(&ring_not_empty);
+  pthread_mutex_unlock(&ring_lock);
+}
+
+void interval_close()
+{
+  pthread_mutex_lock(&ring_lock);
+  ring_closed = 1;
+  pthread_cond_signal(&ring_not_empty);
+  pthread_mutex_unlock(&ring_lock);
+
+  pthread_join(writer, NULL);
+  if (interval_file != stdout)
+  {
+    fclose(interval_file);
+  }
+  else
+  {
+    fflush(stdout);
+  }
+}
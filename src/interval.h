@@ -0,0 +1,40 @@
+//========================================================//
+//  interval.h                                            //
+//  Header file for the interval statistics stream        //
+//                                                        //
+//  Every N conditional branches the simulator queues a   //
+//  record that a background thread writes out as CSV     //
+//========================================================//
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include <stdint.h>
+
+// Statistics of one interval, cumulative and for the interval alone
+typedef struct
+{
+  uint64_t index;
+  uint64_t branches;                // conditional branches so far
+  uint64_t mispredictions;          // mispredictions so far
+  uint64_t interval_branches;       // conditional branches in this interval
+  uint64_t interval_mispredictions; // mispredictions in this interval
+} interval_record_t;
+
+// Open 'path' ("-" for stdout) and start the writer thread
+//
+// Returns True if Successful
+//
+int interval_open(const char *path);
+
+// Queue the statistics of the interval ending at 'branches' conditional
+// branches. Only copies the record into a ring buffer; the file is
+// written by the writer thread.
+//
+void interval_emit(uint64_t branches, uint64_t mispredictions);
+
+// Flush what is still queued, stop the writer thread and close the file
+//
+void interval_close();
+
+#endif
@@ -0,0 +1,225 @@
+//========================================================//
+//  ittage.cpp                                            //
+//  Source file for the indirect target predictor         //
+//                                                        //
+//  Enabled with --ittage, see main.cpp                   //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "history.h"
+#include "ittage.h"
+
+ittage_t ittage;
+
+static const int history_length[ITTAGE_TABLES] = {4, 8, 16, 32, 64, 128, 256};
+static const int tag_width[ITTAGE_TABLES] = {9, 9, 10, 10, 11, 11, 12};
+
+// Folded histories of each table, for its index and its tag
+static int fold_index[ITTAGE_TABLES];
+static int fold_tag[ITTAGE_TABLES][2];
+
+// Where the tables matched for the branch being predicted
+typedef struct
+{
+  uint32_t index[ITTAGE_TABLES];
+  uint16_t tag[ITTAGE_TABLES];
+  int provider;       // longest matching table, -1 for the base table
+  int alt;            // next longest, -1 for the base table
+  uint64_t alt_target;
+  uint64_t target;    // final prediction
+} ittage_lookup_t;
+
+void ittage_init()
+{
+  ittage.tables = (ittage_entry_t *)calloc(ITTAGE_TABLES << ITTAGE_TABLE_BITS, sizeof(ittage_entry_t));
+  ittage.base = (ittage_base_t *)calloc(1 << ITTAGE_BASE_BITS, sizeof(ittage_base_t));
+  ittage.updates = 0;
+  memset(&ittage.stats, 0, sizeof(ittage.stats));
+
+  for (int t = 0; t < ITTAGE_TABLES; t++)
+  {
+    fold_index[t] = history_fold(history_length[t], ITTAGE_TABLE_BITS);
+    fold_tag[t][0] = history_fold(history_length[t], tag_width[t]);
+    fold_tag[t][1] = history_fold(history_length[t], tag_width[t] - 1);
+  }
+}
+
+static ittage_entry_t *entry(int t, uint32_t index)
+{
+  return &ittage.tables[(t << ITTAGE_TABLE_BITS) + index];
+}
+
+static ittage_base_t *base_entry(uint64_t pc)
+{
+  return &ittage.base[(pc ^ (pc >> ITTAGE_BASE_BITS)) & ((1 << ITTAGE_BASE_BITS) - 1)];
+}
+
+static void lookup(uint64_t pc, ittage_lookup_t *l)
+{
+  uint32_t mask = (1 << ITTAGE_TABLE_BITS) - 1;
+  for (int t = 0; t < ITTAGE_TABLES; t++)
+  {
+    int path_bits = history_length[t] < 16 ? history_length[t] : 16;
+    uint64_t path = global_history.path & ((1ULL << path_bits) - 1);
+    l->index[t] = (pc ^ (pc >> ITTAGE_TABLE_BITS) ^ history_folded(fold_index[t]) ^ path ^
+                   (path >> ITTAGE_TABLE_BITS)) & mask;
+    l->tag[t] = (pc ^ history_folded(fold_tag[t][0]) ^ (history_folded(fold_tag[t][1]) << 1)) &
+                ((1 << tag_width[t]) - 1);
+  }
+
+  l->provider = l->alt = -1;
+  for (int t = ITTAGE_TABLES - 1; t >= 0; t--)
+  {
+    ittage_entry_t *e = entry(t, l->index[t]);
+    if (e->valid && e->tag == l->tag[t])
+    {
+      if (l->provider < 0)
+      {
+        l->provider = t;
+      }
+      else
+      {
+        l->alt = t;
+        break;
+      }
+    }
+  }
+
+  l->alt_target = l->alt >= 0 ? entry(l->alt, l->index[l->alt])->target : base_entry(pc)->target;
+  if (l->provider < 0)
+  {
+    l->target = l->alt_target;
+    return;
+  }
+  // A newly allocated entry is not trusted over the alternate prediction
+  ittage_entry_t *e = entry(l->provider, l->index[l->provider]);
+  l->target = e->ctr == 0 ? l->alt_target : e->target;
+}
+
+int ittage_score(uint64_t pc, uint64_t target)
+{
+  ittage_lookup_t l;
+  lookup(pc, &l);
+
+  int correct = l.target == target;
+  ittage.stats.indirect++;
+  ittage.stats.provided[l.provider + 1]++;
+  if (!correct)
+  {
+    ittage.stats.mispredictions++;
+    ittage.stats.provided_wrong[l.provider + 1]++;
+  }
+  return correct;
+}
+
+// Move a target confidence towards 'target', replacing it once it is spent
+static void train_target(uint64_t *entry_target, uint8_t *ctr, uint64_t target)
+{
+  if (*entry_target == target)
+  {
+    if (*ctr < 3)
+    {
+      (*ctr)++;
+    }
+  }
+  else if (*ctr > 0)
+  {
+    (*ctr)--;
+  }
+  else
+  {
+    *entry_target = target;
+  }
+}
+
+void ittage_update(uint64_t pc, uint64_t target)
+{
+  ittage_lookup_t l;
+  lookup(pc, &l);
+
+  if (l.provider >= 0)
+  {
+    ittage_entry_t *e = entry(l.provider, l.index[l.provider]);
+    if ((e->target == target) != (l.alt_target == target))
+    {
+      e->u = e->target == target;
+    }
+    train_target(&e->target, &e->ctr, target);
+  }
+  else
+  {
+    ittage_base_t *b = base_entry(pc);
+    train_target(&b->target, &b->ctr, target);
+  }
+
+  // Allocate one entry in a longer history table on a misprediction,
+  // or age the candidates if none of them is free
+  if (l.target != target && l.provider < ITTAGE_TABLES - 1)
+  {
+    int allocated = 0;
+    for (int t = l.provider + 1; t < ITTAGE_TABLES && !allocated; t++)
+    {
+      ittage_entry_t *e = entry(t, l.index[t]);
+      if (e->u == 0)
+      {
+        e->tag = l.tag[t];
+        e->target = target;
+        e->ctr = 0;
+        e->valid = 1;
+        allocated = 1;
+      }
+    }
+    for (int t = l.provider + 1; t < ITTAGE_TABLES && !allocated; t++)
+    {
+      entry(t, l.index[t])->u = 0;
+    }
+  }
+
+  if (++ittage.updates % ITTAGE_RESET_PERIOD == 0)
+  {
+    for (int i = 0; i < ITTAGE_TABLES << ITTAGE_TABLE_BITS; i++)
+    {
+      ittage.tables[i].u = 0;
+    }
+  }
+}
+
+void ittage_report(uint64_t num_branches, uint64_t instructions)
+{
+  ittage_stats_t *st = &ittage.stats;
+  printf("\nITTAGE (%d tagged tables of %d entries, histories %d-%d):\n", ITTAGE_TABLES,
+         1 << ITTAGE_TABLE_BITS, history_length[0], history_length[ITTAGE_TABLES - 1]);
+  printf("  Indirect branches: %10" PRIu64 "\n", st->indirect);
+  printf("  Mispredicted:      %10" PRIu64 "  %6.2f%%\n", st->mispredictions,
+         st->indirect ? 100.0 * st->mispredictions / st->indirect : 0.0);
+  printf("  Target mispredictions per 1000 conditional branches: %.3f\n",
+         num_branches ? 1000.0 * st->mispredictions / num_branches : 0.0);
+  if (instructions)
+  {
+    printf("  Target MPKI: %.3f\n", 1000.0 * st->mispredictions / instructions);
+  }
+  printf("  %-10s %12s %12s\n", "Provider", "Predictions", "Wrong");
+  for (int t = 0; t <= ITTAGE_TABLES; t++)
+  {
+    char name[16];
+    if (t == 0)
+    {
+      snprintf(name, sizeof(name), "base");
+    }
+    else
+    {
+      snprintf(name, sizeof(name), "T%d (%d)", t, history_length[t - 1]);
+    }
+    printf("  %-10s %12" PRIu64 " %12" PRIu64 "\n", name, st->provided[t], st->provided_wrong[t]);
+  }
+}
+
+void ittage_cleanup()
+{
+  free(ittage.tables);
+  free(ittage.base);
+  ittage.tables = NULL;
+  ittage.base = NULL;
+}
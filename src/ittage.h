@@ -0,0 +1,77 @@
+//========================================================//
+//  ittage.h                                              //
+//  Header file for the indirect target predictor         //
+//                                                        //
+//  An ITTAGE-style predictor: a PC-indexed base table of //
+//  targets and tagged tables indexed with geometrically  //
+//  longer global and path histories                      //
+//========================================================//
+
+#ifndef ITTAGE_H
+#define ITTAGE_H
+
+#include <stdint.h>
+
+#define ITTAGE_TABLES 7
+#define ITTAGE_TABLE_BITS 9 // entries per tagged table, log2
+#define ITTAGE_BASE_BITS 10
+
+// Usefulness bits are cleared after this many updates, so entries that
+// stopped being useful can be replaced
+#define ITTAGE_RESET_PERIOD (1 << 18)
+
+typedef struct
+{
+  uint64_t target;
+  uint16_t tag;
+  uint8_t ctr;   // confidence in the target, 0-3
+  uint8_t u;     // useful: right when the alternate prediction was wrong
+  uint8_t valid; // allocated since ittage_init, so its tag can match
+} ittage_entry_t;
+
+typedef struct
+{
+  uint64_t target;
+  uint8_t ctr;
+} ittage_base_t;
+
+typedef struct
+{
+  uint64_t indirect;       // indirect jumps and calls scored, returns excluded
+  uint64_t mispredictions;
+  uint64_t provided[ITTAGE_TABLES + 1]; // by the base table (0) or tagged table i + 1
+  uint64_t provided_wrong[ITTAGE_TABLES + 1];
+} ittage_stats_t;
+
+typedef struct
+{
+  ittage_entry_t *tables; // ITTAGE_TABLES tables, NULL when the predictor is off
+  ittage_base_t *base;
+  uint64_t updates;
+  ittage_stats_t stats;
+} ittage_t;
+
+extern ittage_t ittage;
+
+// Allocate the predictor, empty, and register its folded histories
+//
+void ittage_init();
+
+// Predict the target of the indirect branch at 'pc' and score it against
+// the actual 'target'. Returns whether it was right.
+//
+int ittage_score(uint64_t pc, uint64_t target);
+
+// Train on the indirect branch at 'pc', which went to 'target'. Must come
+// before the branch is pushed into the global history.
+//
+void ittage_update(uint64_t pc, uint64_t target);
+
+// Print the statistics gathered since ittage_init, over a run of
+// 'num_branches' conditional branches and 'instructions' (0 if unknown)
+//
+void ittage_report(uint64_t num_branches, uint64_t instructions);
+
+void ittage_cleanup();
+
+#endif
@@ -7,12 +7,83 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include "predictor.h"
+#include "profile.h"
+#include "interval.h"
+#include "alias.h"
+#include "timing.h"
+#include "perf.h"
+#include "state.h"
+#include "trace.h"
+#include "parallel.h"
+#include "simpoint.h"
+#include "tracefile.h"
+#include "tracecache.h"
+#include "btb.h"
+#include "ras.h"
+#include "history.h"
+#include "ittage.h"
+#include "delay.h"
+#include "cycles.h"
 
 FILE *stream;
 char *buf = NULL;
 size_t len = 0;
 
+// Set instead of stream when the input is a trace container (tracepack)
+tracefile_t *tracefile = NULL;
+
+// With --cache, the decoded image of the trace file, mapped from cache_dir
+// and read in place
+const char *trace_path = NULL;
+const char *cache_dir = NULL;
+trace_t cached_trace;
+uint64_t cached_next = 0;
+
+// Time the stages of the simulation loop (--timing)
+int time_stages = 0;
+
+// Count hardware events around the simulation loop (--perf)
+int perf = 0;
+
+// Model a branch target buffer next to the direction predictor (--btb)
+int btb_enabled = 0;
+
+// Model a return address stack (--ras)
+int ras_enabled = 0;
+
+// Predict the targets of indirect branches (--ittage)
+int ittage_enabled = 0;
+
+// Report MPKI and the cycles lost to mispredictions (--cycles)
+int cycle_model = 0;
+
+// Number of branches listed by --profile, 0 when profiling is off
+int profile_top = 0;
+
+// Length in conditional branches of the --interval statistics, 0 when off
+uint64_t interval_length = 0;
+const char *interval_path = "intervals.csv";
+
+// Predictor snapshots: saved to state_path after save_at conditional
+// branches (0 for the end of the run), or resumed from load_path
+const char *state_path = NULL;
+uint64_t save_at = 0;
+const char *load_path = NULL;
+
+// Simulate the trace in this many chunks at once (--parallel), each warmed
+// up on parallel_warmup branches; 0 for a sequential run
+int parallel_chunks = 0;
+uint64_t parallel_warmup = 1000000;
+int parallel_exact = 0;
+
+// Estimate the result from representative intervals of simpoint_interval
+// branches in up to simpoint_k clusters (--simpoint); 0 when off
+uint64_t simpoint_interval = 0;
+int simpoint_k = 10;
+int simpoint_exact = 0;
+
 // Print out the Usage information to stderr
 //
 void usage()
@@ -22,6 +93,49 @@ void usage()
   fprintf(stderr, " Options:\n");
   fprintf(stderr, " --help       Print this message\n");
   fprintf(stderr, " --verbose    Print predictions on stdout\n");
+  fprintf(stderr, " --stats      Print internal predictor statistics\n");
+  fprintf(stderr, " --timing     Print time spent per stage and simulation speed\n");
+  fprintf(stderr, " --perf       Print hardware counters of the simulation loop\n");
+  fprintf(stderr, " --btb[=SETS:WAYS:TAGBITS:POLICY] Also simulate a BTB and report\n"
+                  "              direction+target mispredictions (default\n"
+                  "              1024:4:16:lru; 0 tag bits for full tags, policy\n"
+                  "              lru, fifo or random)\n");
+  fprintf(stderr, " --ras[=DEPTH[:POLICY]] Also simulate a return address stack\n"
+                  "              and report return accuracy (default 16:circular;\n"
+                  "              policy circular or counter)\n");
+  fprintf(stderr, " --ittage     Also predict the targets of indirect jumps and\n"
+                  "              calls, and report target mispredictions\n");
+  fprintf(stderr, " --update-delay=N Update the direction tables N conditional\n"
+                  "              branches after each prediction\n");
+  fprintf(stderr, " --cycles     Report MPKI, cycles lost to mispredictions and\n"
+                  "              the speedup over static and perfect prediction\n");
+  fprintf(stderr, " --insts=N    Instructions in the trace, for --cycles (default\n"
+                  "              from the trace's .txt side file)\n");
+  fprintf(stderr, " --penalty=N  Cycles lost per misprediction (default %d)\n", CYCLES_DEFAULT_PENALTY);
+  fprintf(stderr, " --ipc=X      IPC with perfect prediction (default %.1f)\n", CYCLES_DEFAULT_IPC);
+  fprintf(stderr, " --profile[=N] Print the N (default 20) branches with the\n"
+                  "              most mispredictions\n");
+  fprintf(stderr, " --interval=N Write statistics every N conditional branches\n");
+  fprintf(stderr, " --interval-out=<file> CSV file for --interval (default\n"
+                  "              intervals.csv, - for stdout)\n");
+  fprintf(stderr, " --save-state=<file> Save the predictor state at the end of\n"
+                  "              the run, or after --save-at branches\n");
+  fprintf(stderr, " --save-at=N  Save the state after N conditional branches\n");
+  fprintf(stderr, " --load-state=<file> Resume from a saved state, skipping the\n"
+                  "              part of the trace it already covers\n");
+  fprintf(stderr, " --cache[=<dir>] Decode the trace file (text or .bz2) once into\n"
+                  "              a shared image in <dir> (default " TRACECACHE_DIR ") and\n"
+                  "              map it in later runs\n");
+  fprintf(stderr, " --parallel=K Simulate the trace as K chunks in parallel\n");
+  fprintf(stderr, " --parallel-exact Also run sequentially and report the\n"
+                  "              deviation of the --parallel result\n");
+  fprintf(stderr, " --simpoint=N Estimate the result from representative\n"
+                  "              intervals of N branches\n");
+  fprintf(stderr, " --simpoint-k=K Number of --simpoint clusters (default 10)\n");
+  fprintf(stderr, " --simpoint-exact Also run sequentially and report the\n"
+                  "              actual error of the --simpoint estimate\n");
+  fprintf(stderr, " --warmup=N   Branches each --parallel chunk or --simpoint\n"
+                  "              interval trains on first (default 1000000)\n");
   fprintf(stderr, " --<type>     Branch prediction scheme:\n");
   fprintf(stderr, "    static\n"
                   "    gshare\n"
@@ -56,6 +170,169 @@ int handle_option(char *arg)
   {
     verbose = 1;
   }
+  else if (!strcmp(arg, "--stats"))
+  {
+    predictor_stats = 1;
+  }
+  else if (!strcmp(arg, "--timing"))
+  {
+    time_stages = 1;
+  }
+  else if (!strcmp(arg, "--perf"))
+  {
+    perf = 1;
+  }
+  else if (!strcmp(arg, "--btb"))
+  {
+    btb_enabled = 1;
+  }
+  else if (!strncmp(arg, "--btb=", 6))
+  {
+    btb_enabled = 1;
+    if (!btb_config(arg + 6))
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--ras"))
+  {
+    ras_enabled = 1;
+  }
+  else if (!strncmp(arg, "--ras=", 6))
+  {
+    ras_enabled = 1;
+    if (!ras_config(arg + 6))
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--ittage"))
+  {
+    ittage_enabled = 1;
+  }
+  else if (!strncmp(arg, "--update-delay=", 15))
+  {
+    update_delay = atoi(arg + 15);
+    if (update_delay < 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--cycles"))
+  {
+    cycle_model = 1;
+  }
+  else if (!strncmp(arg, "--insts=", 8))
+  {
+    cycle_model = 1;
+    cycles_model.instructions = strtoull(arg + 8, NULL, 0);
+    if (cycles_model.instructions == 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--penalty=", 10))
+  {
+    cycle_model = 1;
+    cycles_model.penalty = atoi(arg + 10);
+    if (cycles_model.penalty < 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--ipc=", 6))
+  {
+    cycle_model = 1;
+    cycles_model.ipc = atof(arg + 6);
+    if (cycles_model.ipc <= 0.0)
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--profile"))
+  {
+    profile_top = 20;
+  }
+  else if (!strncmp(arg, "--profile=", 10))
+  {
+    profile_top = atoi(arg + 10);
+    if (profile_top <= 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--interval=", 11))
+  {
+    interval_length = strtoull(arg + 11, NULL, 0);
+    if (interval_length == 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--interval-out=", 15))
+  {
+    interval_path = arg + 15;
+  }
+  else if (!strncmp(arg, "--save-state=", 13))
+  {
+    state_path = arg + 13;
+  }
+  else if (!strncmp(arg, "--save-at=", 10))
+  {
+    save_at = strtoull(arg + 10, NULL, 0);
+    if (save_at == 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--load-state=", 13))
+  {
+    load_path = arg + 13;
+  }
+  else if (!strcmp(arg, "--cache"))
+  {
+    cache_dir = TRACECACHE_DIR;
+  }
+  else if (!strncmp(arg, "--cache=", 8))
+  {
+    cache_dir = arg + 8;
+  }
+  else if (!strncmp(arg, "--parallel=", 11))
+  {
+    parallel_chunks = atoi(arg + 11);
+    if (parallel_chunks <= 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--warmup=", 9))
+  {
+    parallel_warmup = strtoull(arg + 9, NULL, 0);
+  }
+  else if (!strcmp(arg, "--parallel-exact"))
+  {
+    parallel_exact = 1;
+  }
+  else if (!strncmp(arg, "--simpoint=", 11))
+  {
+    simpoint_interval = strtoull(arg + 11, NULL, 0);
+    if (simpoint_interval == 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--simpoint-k=", 13))
+  {
+    simpoint_k = atoi(arg + 13);
+    if (simpoint_k <= 0)
+    {
+      return 0;
+    }
+  }
+  else if (!strcmp(arg, "--simpoint-exact"))
+  {
+    simpoint_exact = 1;
+  }
   else
   {
     return 0;
@@ -64,23 +341,177 @@ int handle_option(char *arg)
   return 1;
 }
 
+// Next record of the --cache image, 0 once it is exhausted
+static int next_cached(trace_record_t *r)
+{
+  if (cached_next == cached_trace.num_records)
+  {
+    return 0;
+  }
+  *r = cached_trace.records[cached_next++];
+  return 1;
+}
+
 // Reads a line from the input stream and extracts the
-// PC and Outcome of a branch
+// PC and Outcome of a branch. Addresses may be up to 64 bits wide
+// (traces recorded with branchExt -w 64)
 //
 // Returns True if Successful
 //
-int read_branch(uint32_t *pc, uint32_t *target, uint32_t *outcome, uint32_t *condition, uint32_t *call, uint32_t *ret, uint32_t *direct)
+int read_branch(uint64_t *pc, uint64_t *target, uint32_t *outcome, uint32_t *condition, uint32_t *call, uint32_t *ret, uint32_t *direct)
 {
+  if (tracefile || cached_trace.records)
+  {
+    trace_record_t r;
+    if (!(cached_trace.records ? next_cached(&r) : tracefile_next(tracefile, &r)))
+    {
+      return 0;
+    }
+    *pc = r.pc;
+    *target = r.target;
+    *outcome = r.outcome;
+    *condition = r.condition;
+    *call = r.call;
+    *ret = r.ret;
+    *direct = r.direct;
+    return 1;
+  }
+
   if (getline(&buf, &len, stream) == -1)
   {
     return 0;
   }
 
-  sscanf(buf, "0x%x\t0x%x\t%d\t%d\t%d\t%d\t%d\n", pc, target, outcome, condition, call, ret, direct);
+  sscanf(buf, "0x%" SCNx64 "\t0x%" SCNx64 "\t%d\t%d\t%d\t%d\t%d\n", pc, target, outcome, condition, call, ret, direct);
 
   return 1;
 }
 
+// Skip the first 'n' records of the trace, already simulated by the run
+// a snapshot comes from. Returns the number skipped.
+//
+uint64_t skip_records(uint64_t n)
+{
+  if (cached_trace.records)
+  {
+    cached_next = n < cached_trace.num_records ? n : cached_trace.num_records;
+    return cached_next;
+  }
+  if (tracefile)
+  {
+    return tracefile_seek(tracefile, n) ? n : 0;
+  }
+
+  uint64_t skipped = 0;
+  while (skipped < n && getline(&buf, &len, stream) > 0)
+  {
+    skipped++;
+  }
+  return skipped;
+}
+
+// Close the input trace, however it was opened
+//
+void close_input()
+{
+  if (cached_trace.records)
+  {
+    tracecache_close(&cached_trace);
+  }
+  if (tracefile)
+  {
+    tracefile_close(tracefile);
+    tracefile = NULL;
+  }
+  if (stream)
+  {
+    fclose(stream);
+    stream = NULL;
+  }
+  free(buf);
+  buf = NULL;
+}
+
+// Save the predictor state after 'records' records, exiting on failure
+//
+void save_state(uint64_t records, uint64_t num_branches, uint64_t mispredictions)
+{
+  state_position_t pos = {records, num_branches, mispredictions};
+  if (!state_save(state_path, &pos))
+  {
+    fprintf(stderr, "Unable to save the predictor state to %s\n", state_path);
+    close_input();
+    exit(1);
+  }
+}
+
+// Print out the mispredict statistics
+//
+void print_results(uint64_t num_branches, uint64_t mispredictions)
+{
+  printf("Branches:        %10" PRIu64 "\n", num_branches);
+  printf("Incorrect:       %10" PRIu64 "\n", mispredictions);
+  float mispredict_rate = 1000 * ((float)mispredictions / (float)num_branches);
+  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+}
+
+// Simulate the trace in --parallel chunks or from --simpoint intervals,
+// both of which load it into memory first
+//
+int run_in_memory()
+{
+  if (verbose || profile_top || interval_length || state_path || load_path || btb_enabled || ras_enabled || ittage_enabled || update_delay ||
+      (parallel_chunks && simpoint_interval))
+  {
+    fprintf(stderr, "--parallel and --simpoint cannot be combined with each other, --verbose, "
+                    "--profile, --interval, --save-state, --load-state, --btb, --ras, --ittage or --update-delay\n");
+    return 1;
+  }
+
+  // A cached image is used as it is, read-only
+  trace_t trace = cached_trace;
+  if (!cached_trace.records && !(tracefile ? tracefile_load(tracefile, &trace) : trace_load(stream, &trace)))
+  {
+    fprintf(stderr, "Not enough memory to load the trace\n");
+    return 1;
+  }
+
+  uint64_t num_branches, mispredictions;
+  int ok;
+  if (parallel_chunks)
+  {
+    ok = parallel_run(&trace, parallel_chunks, parallel_warmup, parallel_exact,
+                      &num_branches, &mispredictions);
+  }
+  else
+  {
+    ok = simpoint_run(&trace, simpoint_interval, simpoint_k, parallel_warmup, simpoint_exact,
+                      &num_branches, &mispredictions);
+  }
+  if (!ok)
+  {
+    fprintf(stderr, "A simulation worker failed\n");
+    return 1;
+  }
+
+  print_results(num_branches, mispredictions);
+  if (cycle_model)
+  {
+    // Always taken mispredicts every not-taken branch
+    uint64_t not_taken = 0;
+    for (uint64_t i = 0; i < trace.num_records; i++)
+    {
+      not_taken += trace.records[i].condition && !trace.records[i].outcome;
+    }
+    cycles_report(num_branches, mispredictions, not_taken);
+  }
+  if (!cached_trace.records)
+  {
+    trace_free(&trace);
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[])
 {
   // Set defaults
@@ -102,59 +533,298 @@ int main(int argc, char *argv[])
       {
         printf("Unrecognized option %s\n", argv[i]);
         usage();
+        close_input();
+        exit(1);
+      }
+    }
+    else if (tracefile_probe(argv[i]))
+    {
+      // Use as input trace container
+      trace_path = argv[i];
+      tracefile = tracefile_open(argv[i]);
+      if (tracefile == NULL)
+      {
+        fprintf(stderr, "Unable to read %s\n", argv[i]);
+        close_input();
         exit(1);
       }
     }
     else
     {
       // Use as input file
+      trace_path = argv[i];
       stream = fopen(argv[i], "r");
     }
   }
 
+  if (cache_dir)
+  {
+    if (trace_path == NULL || tracefile)
+    {
+      fprintf(stderr, "--cache needs a text or .bz2 trace file\n");
+      close_input();
+      exit(1);
+    }
+    if (!tracecache_open(cache_dir, trace_path, &cached_trace))
+    {
+      close_input();
+      exit(1);
+    }
+  }
+
+  if (cycle_model && cycles_model.instructions == 0 &&
+      (trace_path == NULL || !cycles_side_instructions(trace_path, &cycles_model.instructions)))
+  {
+    fprintf(stderr, "--cycles needs --insts or a trace with a .txt side file\n");
+    close_input();
+    exit(1);
+  }
+
+  if (parallel_chunks || simpoint_interval)
+  {
+    int status = run_in_memory();
+    close_input();
+    return status;
+  }
+
+  if (save_at && state_path == NULL)
+  {
+    fprintf(stderr, "--save-at needs --save-state\n");
+    close_input();
+    exit(1);
+  }
+  if (update_delay && (state_path || load_path))
+  {
+    // Snapshots do not hold the updates still in flight
+    fprintf(stderr, "--update-delay cannot be combined with --save-state or --load-state\n");
+    close_input();
+    exit(1);
+  }
+
   // Initialize the predictor
   init_predictor();
+  if (btb_enabled)
+  {
+    btb_init();
+  }
+  if (ras_enabled)
+  {
+    ras_init();
+  }
+  if (update_delay)
+  {
+    delay_init();
+  }
+  if (ittage_enabled)
+  {
+    history_init();
+    ittage_init();
+  }
+
+  // Resume from a snapshot
+  state_position_t resume = {0, 0, 0};
+  if (load_path)
+  {
+    if (!state_load(load_path, &resume))
+    {
+      close_input();
+      exit(1);
+    }
+    if (skip_records(resume.records) != resume.records)
+    {
+      fprintf(stderr, "Trace is shorter than the %" PRIu64 " records of %s\n", resume.records, load_path);
+      close_input();
+      exit(1);
+    }
+  }
+  if (profile_top)
+  {
+    profile_init();
+  }
+  if (interval_length && !interval_open(interval_path))
+  {
+    fprintf(stderr, "Unable to open %s\n", interval_path);
+    close_input();
+    exit(1);
+  }
+  uint64_t next_interval = interval_length ? (resume.num_branches / interval_length + 1) * interval_length : 0;
+  if (time_stages)
+  {
+    timing_start();
+  }
+  if (perf)
+  {
+    perf_open();
+    perf_start();
+  }
 
-  uint32_t num_branches = 0;
-  uint32_t mispredictions = 0;
-  uint32_t pc = 0;
-  uint32_t target = 0;
+  uint64_t num_branches = resume.num_branches;
+  uint64_t mispredictions = resume.mispredictions;
+  uint64_t pc = 0;
+  uint64_t target = 0;
   uint32_t outcome = NOTTAKEN;
   uint32_t condition = 0;
   uint32_t call = 0;
   uint32_t ret = 0;
   uint32_t direct = 0;
 
+  uint64_t records = 0; // since the start of the run or the resume point
+  uint64_t not_taken = 0;
+  int state_saved = 0;
+  int timed = time_stages && timing_sample();
+
   // Reach each branch from the trace
   while (read_branch(&pc, &target, &outcome, &condition, &call, &ret, &direct))
   {
+    if (timed)
+    {
+      timing_mark(STAGE_READ);
+    }
+    uint32_t prediction = TAKEN;
     if (condition == 1)
     {
       num_branches++;
+      not_taken += !outcome;
       // Make a prediction and compare with actual outcome
-      uint32_t prediction = make_prediction(pc, target, direct);
+      prediction = make_prediction64(pc, target, direct);
       if (prediction != outcome)
       {
         mispredictions++;
       }
+      if (update_delay)
+      {
+        delay_branch(pc, outcome);
+      }
+      if (timed)
+      {
+        timing_mark(STAGE_PREDICT);
+      }
+      if (profile_top)
+      {
+        profile_update(pc, outcome, prediction, provider);
+      }
       if (verbose != 0)
       {
         printf("%d\n", prediction);
       }
+      if (num_branches == next_interval)
+      {
+        interval_emit(num_branches, mispredictions);
+        next_interval += interval_length;
+      }
+      if (timed)
+      {
+        timing_mark(STAGE_OUTPUT);
+      }
+    }
+    int target_correct = -1;
+    if (ras_enabled && ret)
+    {
+      target_correct = ras_score(target);
+    }
+    if (ittage_enabled && !direct && !ret)
+    {
+      target_correct = ittage_score(pc, target);
+    }
+    if (btb_enabled)
+    {
+      btb_score(pc, target, outcome, condition, prediction, target_correct);
     }
     // Train the predictor
-    train_predictor(pc, target, outcome, condition, call, ret, direct);
+    train_predictor64(pc, target, outcome, condition, call, ret, direct);
+    if (timed)
+    {
+      timing_mark(STAGE_TRAIN);
+    }
+
+    records++;
+    timed = time_stages && timing_sample();
+
+    if (save_at && !state_saved && num_branches == save_at)
+    {
+      save_state(resume.records + records, num_branches, mispredictions);
+      state_saved = 1;
+    }
+  }
+
+  if (perf)
+  {
+    perf_stop();
+  }
+
+  if (state_path && !state_saved)
+  {
+    save_state(resume.records + records, num_branches, mispredictions);
+  }
+
+  if (interval_length)
+  {
+    // Last, partial interval
+    if (num_branches + interval_length != next_interval)
+    {
+      interval_emit(num_branches, mispredictions);
+    }
+    interval_close();
   }
 
   // Print out the mispredict statistics
-  printf("Branches:        %10d\n", num_branches);
-  printf("Incorrect:       %10d\n", mispredictions);
-  float mispredict_rate = 1000 * ((float)mispredictions / (float)num_branches);
-  printf("Misprediction Rate: %7.3f\n", mispredict_rate);
+  print_results(num_branches, mispredictions);
+
+  if (cycle_model)
+  {
+    // The static count only covers the trace from the resume point
+    cycles_report(num_branches, mispredictions, load_path ? -1 : (int64_t)not_taken);
+  }
+
+  if (predictor_stats)
+  {
+    print_predictor_stats(num_branches, mispredictions);
+  }
+
+  if (btb_enabled)
+  {
+    btb_report();
+    btb_cleanup();
+  }
+
+  if (ras_enabled)
+  {
+    ras_report(num_branches - resume.num_branches, mispredictions - resume.mispredictions);
+    ras_cleanup();
+  }
+
+  if (update_delay)
+  {
+    delay_report();
+    delay_cleanup();
+  }
+
+  if (ittage_enabled)
+  {
+    ittage_report(num_branches - resume.num_branches, load_path ? 0 : cycles_model.instructions);
+    ittage_cleanup();
+  }
+
+  ALIAS_REPORT();
+
+  if (time_stages)
+  {
+    timing_report(records, num_branches);
+  }
+
+  if (perf)
+  {
+    perf_report(bpName[bpType], num_branches);
+  }
+
+  if (profile_top)
+  {
+    profile_report(profile_top, num_branches, mispredictions);
+    profile_cleanup();
+  }
 
   // Cleanup
-  fclose(stream);
-  free(buf);
+  close_input();
 
   return 0;
 }
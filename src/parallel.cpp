@@ -0,0 +1,136 @@
+//========================================================//
+//  parallel.cpp                                          //
+//  Source file for chunked parallel simulation           //
+//                                                        //
+//  Enabled with --parallel, see main.cpp                 //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/wait.h>
+#include "predictor.h"
+#include "parallel.h"
+
+// The predictors keep their tables in globals, so every chunk runs in a
+// forked worker process with its own copy of them rather than in a thread.
+// The trace is loaded before forking and shared copy-on-write.
+
+// Train on records [warm, start) and simulate records [start, end)
+static void simulate(const trace_t *trace, sim_range_t *range)
+{
+  init_predictor();
+
+  for (uint64_t i = range->warm; i < range->end; i++)
+  {
+    const trace_record_t *r = &trace->records[i];
+    if (i >= range->start && r->condition == 1)
+    {
+      range->num_branches++;
+      if (make_prediction64(r->pc, r->target, r->direct) != r->outcome)
+      {
+        range->mispredictions++;
+      }
+    }
+    train_predictor64(r->pc, r->target, r->outcome, r->condition, r->call, r->ret, r->direct);
+  }
+}
+
+// Counts sent back by a worker
+typedef struct
+{
+  int index;
+  uint64_t num_branches;
+  uint64_t mispredictions;
+} sim_result_t;
+
+int simulate_ranges(const trace_t *trace, sim_range_t *ranges, int n)
+{
+  int fds[2];
+  if (pipe(fds) != 0)
+  {
+    return 0;
+  }
+
+  int workers = 0;
+  for (int i = 0; i < n; i++)
+  {
+    ranges[i].num_branches = 0;
+    ranges[i].mispredictions = 0;
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+      close(fds[0]);
+      simulate(trace, &ranges[i]);
+      sim_result_t result = {i, ranges[i].num_branches, ranges[i].mispredictions};
+      _exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+    }
+    workers += pid > 0;
+  }
+  close(fds[1]);
+
+  sim_result_t result;
+  int received = 0;
+  while (read(fds[0], &result, sizeof(result)) == sizeof(result))
+  {
+    ranges[result.index].num_branches = result.num_branches;
+    ranges[result.index].mispredictions = result.mispredictions;
+    received++;
+  }
+  close(fds[0]);
+  while (wait(NULL) > 0)
+  {
+  }
+
+  return workers == n && received == n;
+}
+
+int parallel_run(const trace_t *trace, int chunks, uint64_t warmup, int exact,
+                 uint64_t *num_branches, uint64_t *mispredictions)
+{
+  // Chunk c covers conditional branches [c * B / chunks, (c + 1) * B / chunks);
+  // the exact sequential run, if any, comes last
+  sim_range_t *ranges = (sim_range_t *)calloc(chunks + 1, sizeof(sim_range_t));
+  for (int c = 0; c < chunks; c++)
+  {
+    uint64_t first = (uint64_t)c * trace->num_branches / chunks;
+    uint64_t next = (uint64_t)(c + 1) * trace->num_branches / chunks;
+    ranges[c].warm = first > warmup ? trace_find_branch(trace, first - warmup) : 0;
+    ranges[c].start = c ? trace_find_branch(trace, first) : 0;
+    ranges[c].end = c + 1 < chunks ? trace_find_branch(trace, next) : trace->num_records;
+  }
+  sim_range_t *sequential = &ranges[chunks];
+  sequential->end = trace->num_records;
+
+  int ok = simulate_ranges(trace, ranges, chunks + (exact != 0));
+
+  *num_branches = 0;
+  *mispredictions = 0;
+  for (int c = 0; c < chunks; c++)
+  {
+    *num_branches += ranges[c].num_branches;
+    *mispredictions += ranges[c].mispredictions;
+  }
+
+  if (ok)
+  {
+    printf("Parallel simulation: %d chunks, warm-up %" PRIu64 " branches\n", chunks, warmup);
+    printf("  %-6s %12s %12s %10s\n", "Chunk", "Branches", "Incorrect", "Rate");
+    for (int c = 0; c < chunks; c++)
+    {
+      printf("  %-6d %12" PRIu64 " %12" PRIu64 " %10.3f\n", c, ranges[c].num_branches, ranges[c].mispredictions,
+             ranges[c].num_branches ? 1000.0 * ranges[c].mispredictions / ranges[c].num_branches : 0.0);
+    }
+    if (exact)
+    {
+      int64_t deviation = (int64_t)*mispredictions - (int64_t)sequential->mispredictions;
+      printf("  Sequential Incorrect: %10" PRIu64 "\n", sequential->mispredictions);
+      printf("  Deviation:            %+10" PRId64 " (%+.3f%%)\n", deviation,
+             sequential->mispredictions ? 100.0 * deviation / sequential->mispredictions : 0.0);
+    }
+    printf("\n");
+  }
+
+  free(ranges);
+  return ok;
+}
@@ -0,0 +1,42 @@
+//========================================================//
+//  parallel.h                                            //
+//  Header file for chunked parallel simulation           //
+//                                                        //
+//  Splits a trace into chunks simulated concurrently,    //
+//  each after warming up on the branches before it       //
+//========================================================//
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// A part of a trace simulated on its own predictor instance: trained on
+// records [warm, start), then counted over records [start, end)
+typedef struct
+{
+  uint64_t warm;
+  uint64_t start;
+  uint64_t end;
+  uint64_t num_branches;   // results
+  uint64_t mispredictions;
+} sim_range_t;
+
+// Simulate every one of the 'n' ranges, all at once, each in its own
+// worker process with a fresh predictor of the current type. Returns 0
+// if a worker failed.
+//
+int simulate_ranges(const trace_t *trace, sim_range_t *ranges, int n);
+
+// Simulate the current predictor type over 'trace' in 'chunks' chunks of
+// equally many conditional branches. Each chunk first trains a fresh
+// predictor on up to 'warmup' conditional branches preceding it, without
+// counting them. With 'exact', the whole trace is also simulated
+// sequentially, alongside the chunks, to report the deviation of the
+// combined counts. Returns the combined counts; 0 if a worker failed.
+//
+int parallel_run(const trace_t *trace, int chunks, uint64_t warmup, int exact,
+                 uint64_t *num_branches, uint64_t *mispredictions);
+
+#endif
@@ -0,0 +1,141 @@
+//========================================================//
+//  perf.cpp                                              //
+//  Source file for the hardware performance counters     //
+//                                                        //
+//  Enabled with --perf, see main.cpp                     //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+#define CACHE_READ_MISS(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+typedef struct
+{
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+  int fd;
+  uint64_t value[3]; // count, time enabled, time running
+} perf_counter_t;
+
+static perf_counter_t counters[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1, {0, 0, 0}},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, -1, {0, 0, 0}},
+    {"L1D-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D), -1, {0, 0, 0}},
+    {"LLC-misses", PERF_TYPE_HW_CACHE, CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL), -1, {0, 0, 0}},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, -1, {0, 0, 0}},
+};
+
+#define NUM_COUNTERS (int)(sizeof(counters) / sizeof(counters[0]))
+
+static int perf_errno = 0;
+
+int perf_open()
+{
+  int opened = 0;
+
+  for (int i = 0; i < NUM_COUNTERS; i++)
+  {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counters[i].type;
+    attr.config = counters[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // The counters are opened one by one rather than as a group so a
+    // missing one does not take the others down; scaling by the time
+    // running corrects for any multiplexing.
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    counters[i].fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (counters[i].fd < 0)
+    {
+      perf_errno = errno;
+    }
+    else
+    {
+      opened++;
+    }
+  }
+
+  return opened;
+}
+
+void perf_start()
+{
+  for (int i = 0; i < NUM_COUNTERS; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(counters[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+void perf_stop()
+{
+  for (int i = 0; i < NUM_COUNTERS; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      ioctl(counters[i].fd, PERF_EVENT_IOC_DISABLE, 0);
+      if (read(counters[i].fd, counters[i].value, sizeof(counters[i].value)) != sizeof(counters[i].value))
+      {
+        close(counters[i].fd);
+        counters[i].fd = -1;
+      }
+    }
+  }
+}
+
+void perf_report(const char *name, uint64_t num_branches)
+{
+  printf("\nHardware counters (%s):\n", name);
+  printf("  %-14s %16s %12s\n", "Event", "Count", "Per branch");
+
+  uint64_t count[NUM_COUNTERS];
+  int available = 0;
+  for (int i = 0; i < NUM_COUNTERS; i++)
+  {
+    perf_counter_t *c = &counters[i];
+    if (c->fd < 0)
+    {
+      printf("  %-14s %16s\n", c->name, "n/a");
+      continue;
+    }
+    available++;
+    count[i] = c->value[2] ? (uint64_t)((double)c->value[0] * c->value[1] / c->value[2]) : 0;
+    printf("  %-14s %16" PRIu64 " %12.3f%s\n", c->name, count[i],
+           num_branches ? (double)count[i] / num_branches : 0.0,
+           c->value[2] < c->value[1] ? "  (scaled)" : "");
+  }
+
+  if (!available)
+  {
+    printf("  Counters unavailable: %s\n", strerror(perf_errno));
+  }
+  else if (counters[0].fd >= 0 && counters[1].fd >= 0 && count[0])
+  {
+    printf("  IPC:           %16.3f\n", (double)count[1] / count[0]);
+  }
+
+  for (int i = 0; i < NUM_COUNTERS; i++)
+  {
+    if (counters[i].fd >= 0)
+    {
+      close(counters[i].fd);
+      counters[i].fd = -1;
+    }
+  }
+}
@@ -0,0 +1,29 @@
+//========================================================//
+//  perf.h                                                //
+//  Header file for the hardware performance counters     //
+//                                                        //
+//  Counts the simulator's own cycles, instructions and   //
+//  misses through perf_event_open (no external tools)    //
+//========================================================//
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Open the counters. Counters the kernel refuses (containers, VMs,
+// perf_event_paranoid) are skipped; returns the number opened.
+//
+int perf_open();
+
+// Start and stop counting around the simulation loop
+//
+void perf_start();
+void perf_stop();
+
+// Print the counts, in total and per simulated conditional branch, for
+// predictor 'name'
+//
+void perf_report(const char *name, uint64_t num_branches);
+
+#endif
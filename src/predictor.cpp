@@ -7,7 +7,14 @@
 //========================================================//
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
+#include <inttypes.h>
 #include "predictor.h"
+#include "alias.h"
+#include "btb.h"
+#include "ras.h"
+#include "history.h"
+#include "ittage.h"
 
 
 //
@@ -30,6 +37,22 @@ int ghistoryBits = 17; // Number of bits used for Global History
 int bpType;            // Branch Prediction Type
 int verbose;
 
+// Delay of the direction table updates, 0 to train right away
+int update_delay = 0;
+
+// Component that provided the last prediction
+uint32_t provider;
+
+// Gather the statistics below while training (--stats)
+int predictor_stats = 0;
+
+// Chooser statistics of the tournament and custom predictors
+hybrid_stats_t hybrid_stats;
+
+// Training statistics of the perceptron tables
+perceptron_stats_t perceptron_stats = {"perceptron", 35, {{0}}, 0, 0, 0, 0};
+perceptron_stats_t plt_perceptron_stats = {"PLT perceptron", 37, {{0}}, 0, 0, 0, 0};
+
 //------------------------------------//
 //      Predictor Data Structures     //
 //------------------------------------//
@@ -95,6 +118,57 @@ uint64_t plt_chooser_ghr;
 // Initialize the predictor
 
 
+// Account one trained branch of a hybrid predictor whose chooser
+// selected component 'chosen'
+static inline void hybrid_update(uint32_t chosen, int global_correct, int local_correct)
+{
+  int correct[NUM_COMPONENTS];
+  correct[COMP_GLOBAL] = global_correct;
+  correct[COMP_LOCAL] = local_correct;
+
+  hybrid_stats.predictions++;
+  hybrid_stats.chosen[chosen]++;
+  hybrid_stats.correct[COMP_GLOBAL] += global_correct;
+  hybrid_stats.correct[COMP_LOCAL] += local_correct;
+  hybrid_stats.chosen_correct[chosen] += correct[chosen];
+  hybrid_stats.oracle_correct += (global_correct | local_correct);
+  hybrid_stats.chooser_wrong += (!correct[chosen] && correct[1 - chosen]);
+}
+
+// Account one trained branch of a perceptron table, whose output was
+// 'dot_product'
+static inline void perceptron_account(perceptron_stats_t *st, int dot_product, int correct, int update)
+{
+  int bucket = abs(dot_product) / PERCEPTRON_BUCKET_WIDTH;
+  if (bucket >= PERCEPTRON_BUCKETS)
+  {
+    bucket = PERCEPTRON_BUCKETS - 1;
+  }
+  st->histogram[correct][bucket]++;
+  if (update)
+  {
+    st->updates++;
+    st->updates_mispredicted += !correct;
+  }
+}
+
+// Track the range of the bias and weights of a row written back to a
+// perceptron table
+static inline void perceptron_track_row(perceptron_stats_t *st, const int *row, int width)
+{
+  for (int i = 0; i < width; i++)
+  {
+    if (row[i] > st->max_weight)
+    {
+      st->max_weight = row[i];
+    }
+    if (row[i] < st->min_weight)
+    {
+      st->min_weight = row[i];
+    }
+  }
+}
+
 //bimodal predictor functions 
 void init_bimodal()
 {
@@ -105,7 +179,7 @@ void init_bimodal()
   }
 }
 
-uint8_t bimodal_predict(uint32_t pc) {
+uint8_t bimodal_predict(uint64_t pc) {
   uint32_t bht_entries = 1 << 18;
 
   // Gets the last 17-bits of the PC
@@ -127,7 +201,7 @@ uint8_t bimodal_predict(uint32_t pc) {
   }
 }
 
-void train_bimodal(uint32_t pc, uint8_t outcome)
+void train_bimodal(uint64_t pc, uint8_t outcome)
 {
   uint32_t bht_entries = 1 << 18;
     
@@ -173,9 +247,10 @@ void init_gshare()
     bht_gshare[i] = WN;
   }
   ghistory = 0;
+  ALIAS_REGISTER(ALIAS_GSHARE, "gshare BHT", bht_entries);
 }
 
-uint8_t gshare_predict(uint32_t pc)
+uint8_t gshare_predict(uint64_t pc)
 {
   // get lower ghistoryBits of pc
   uint32_t bht_entries = 1 << ghistoryBits;
@@ -198,7 +273,13 @@ uint8_t gshare_predict(uint32_t pc)
   }
 }
 
-void train_gshare(uint32_t pc, uint8_t outcome)
+// Update history register
+static void gshare_update_history(uint8_t outcome)
+{
+  ghistory = ((ghistory << 1) | outcome);
+}
+
+void train_gshare(uint64_t pc, uint8_t outcome)
 {
   // get lower ghistoryBits of pc
   uint32_t bht_entries = 1 << ghistoryBits;
@@ -206,6 +287,8 @@ void train_gshare(uint32_t pc, uint8_t outcome)
   uint32_t ghistory_lower_bits = ghistory & (bht_entries - 1);
   uint32_t index = pc_lower_bits ^ ghistory_lower_bits;
 
+  ALIAS_TOUCH(ALIAS_GSHARE, index, pc, (bht_gshare[index] >= WT) == outcome);
+
   // Update state of entry in bht based on outcome
   switch (bht_gshare[index])
   {
@@ -226,8 +309,7 @@ void train_gshare(uint32_t pc, uint8_t outcome)
     break;
   }
 
-  // Update history register
-  ghistory = ((ghistory << 1) | outcome);
+  gshare_update_history(outcome);
 }
 
 void cleanup_gshare()
@@ -270,9 +352,14 @@ void init_tournament(){
     tournament_pht_chooser[i] = 2;  
   }
 
+  ALIAS_REGISTER(ALIAS_TOURNAMENT_LOCAL_BHT, "tournament local BHT", local_pht_size);
+  ALIAS_REGISTER(ALIAS_TOURNAMENT_LOCAL_PHT, "tournament local PHT", local_pht_size);
+  ALIAS_REGISTER(ALIAS_TOURNAMENT_GLOBAL_PHT, "tournament global PHT", global_pht_size);
+  ALIAS_REGISTER(ALIAS_TOURNAMENT_CHOOSER, "tournament chooser", chooser_size);
+
 }
 
-uint8_t tournament_predict_local(uint32_t pc){
+uint8_t tournament_predict_local(uint64_t pc){
   uint32_t bht_entries = 1 << tournament_local_pht_width;
   // Gets the last 10-bits of the PC
   uint32_t local_bht_index = pc & ((1 << tournament_local_pht_width) - 1);
@@ -297,7 +384,7 @@ uint8_t tournament_predict_local(uint32_t pc){
 
 }
 
-uint8_t tournament_predict_global(uint32_t pc){
+uint8_t tournament_predict_global(uint64_t pc){
   // Update history register - NOT NEEDED HERE
   //tournament_ghr = ((tournament_ghr << 1) | outcome);
   
@@ -321,7 +408,7 @@ uint8_t tournament_predict_global(uint32_t pc){
 
 }
 
-uint8_t tournament_predict(uint32_t pc){
+uint8_t tournament_predict(uint64_t pc){
   // Uses the chooser
   uint8_t local = tournament_predict_local(pc);
   uint8_t global = tournament_predict_global(pc);
@@ -337,13 +424,27 @@ uint8_t tournament_predict(uint32_t pc){
     3: local
   */
   if(tournament_pht_chooser[tournament_chooser_index] >= 2) {
+    provider = COMP_LOCAL;
     return local;
   } else {
+    provider = COMP_GLOBAL;
     return global;
   }
 }
 
-void train_tournament(int32_t pc, uint8_t outcome) {
+// Shift the outcome into the local history of 'pc' and the global history
+static void tournament_update_history(uint64_t pc, uint8_t outcome)
+{
+  uint32_t tournament_local_index = pc & ((1 << tournament_local_pht_width) - 1);
+  tournament_bht_local[tournament_local_index] = ((tournament_bht_local[tournament_local_index] << 1) | outcome);
+
+  // Update history register
+  tournament_ghr = ((tournament_ghr << 1) | outcome);
+  // Masking to correct width
+  tournament_ghr = (tournament_ghr) & ((1 << tournament_ghr_width) - 1);
+}
+
+void train_tournament(uint64_t pc, uint8_t outcome) {
 
   uint8_t local = tournament_predict_local(pc);
   uint8_t global = tournament_predict_global(pc);
@@ -351,6 +452,15 @@ void train_tournament(int32_t pc, uint8_t outcome) {
   int chooser_size = 1 << tournament_chooser_width;
   uint32_t tournament_chooser_index = tournament_ghr & (chooser_size - 1);
 
+  ALIAS_TOUCH(ALIAS_TOURNAMENT_CHOOSER, tournament_chooser_index, pc,
+              (tournament_pht_chooser[tournament_chooser_index] >= 2 ? local : global) == outcome);
+
+  if (predictor_stats)
+  {
+    hybrid_update(tournament_pht_chooser[tournament_chooser_index] >= 2 ? COMP_LOCAL : COMP_GLOBAL,
+                  global == outcome, local == outcome);
+  }
+
   if(local == outcome && global != outcome){
     // Wrap around for 2-bit sat counter
     if(tournament_pht_chooser[tournament_chooser_index] >= 3){
@@ -397,6 +507,9 @@ void train_tournament(int32_t pc, uint8_t outcome) {
   uint16_t current_pattern = tournament_bht_local[tournament_local_index];
   uint16_t current_pattern_10bits = current_pattern & 0x3FF;
 
+  ALIAS_TOUCH(ALIAS_TOURNAMENT_LOCAL_BHT, tournament_local_index, pc, local == outcome);
+  ALIAS_TOUCH(ALIAS_TOURNAMENT_LOCAL_PHT, current_pattern_10bits, pc, local == outcome);
+
   switch (tournament_pht_local[current_pattern_10bits])
   {
   case WN:
@@ -418,6 +531,8 @@ void train_tournament(int32_t pc, uint8_t outcome) {
 
   uint32_t tournament_ghr_pht_index = tournament_ghr & ((1 << tournament_ghr_width) - 1);
 
+  ALIAS_TOUCH(ALIAS_TOURNAMENT_GLOBAL_PHT, tournament_ghr_pht_index, pc, global == outcome);
+
   //Index global history with 12-b global pattern
   switch(tournament_pht_global[tournament_ghr_pht_index]){
     case WN:
@@ -437,12 +552,7 @@ void train_tournament(int32_t pc, uint8_t outcome) {
     break;
   }
 
-  tournament_bht_local[tournament_local_index] = ((tournament_bht_local[tournament_local_index] << 1) | outcome);
-
-  // Update history register
-  tournament_ghr = ((tournament_ghr << 1) | outcome);
-  // Masking to correct width
-  tournament_ghr = (tournament_ghr) & ((1 << tournament_ghr_width) - 1);
+  tournament_update_history(pc, outcome);
 }
 
 void cleanup_tournament(){
@@ -471,7 +581,7 @@ void init_perceptron(){
   
 }
 
-uint8_t perceptron_predict(uint32_t pc){
+uint8_t perceptron_predict(uint64_t pc){
   uint32_t perceptron_entries = 1 << perceptron_table_size;
   
   // Gets the last 16-bits of the PC
@@ -494,7 +604,7 @@ uint8_t perceptron_predict(uint32_t pc){
   return dot_product > 0 ? TAKEN:NOTTAKEN;
 }
 
-void train_perceptron(int32_t pc, uint8_t outcome){
+void train_perceptron(uint64_t pc, uint8_t outcome){
   uint32_t perceptron_entries = 1 << perceptron_table_size; // 2^16
   
   // Gets the last 16-bits of the PC
@@ -521,6 +631,12 @@ void train_perceptron(int32_t pc, uint8_t outcome){
   int t = (outcome == TAKEN) ? 1:-1;
 
 
+  if (predictor_stats)
+  {
+    perceptron_account(&perceptron_stats, dot_product, result_T_NT == outcome,
+                       result_T_NT != outcome || abs(dot_product) <= 35);
+  }
+
   if(result_T_NT != outcome || abs(dot_product) <= 35 ){
 
       int bias = current_perc[0];
@@ -535,6 +651,10 @@ void train_perceptron(int32_t pc, uint8_t outcome){
         //Update weight back into actual perceptron table
         perceptron_table[perceptron_table_index][i] = new_weight;
       }
+      if (predictor_stats)
+      {
+        perceptron_track_row(&perceptron_stats, perceptron_table[perceptron_table_index], perceptron_weight_bias_width);
+      }
   }
 
   // Update GHR
@@ -582,9 +702,14 @@ void init_plt(){
     plt_pht_chooser[i] = 2;  
   }
 
+  ALIAS_REGISTER(ALIAS_PLT_PERCEPTRON, "PLT perceptron table", perceptron_table_entries);
+  ALIAS_REGISTER(ALIAS_PLT_LOCAL_BHT, "PLT local BHT", local_pht_size);
+  ALIAS_REGISTER(ALIAS_PLT_LOCAL_PHT, "PLT local PHT", local_pht_size);
+  ALIAS_REGISTER(ALIAS_PLT_CHOOSER, "PLT chooser", chooser_size);
+
 }
 
-uint8_t plt_local_predict(uint32_t pc){
+uint8_t plt_local_predict(uint64_t pc){
   uint32_t bht_entries = 1 << plt_local_pht_width;
   // Gets the last 12-bits of the PC
   uint32_t local_bht_index = pc & ((1 << plt_local_pht_width) - 1);
@@ -610,7 +735,7 @@ uint8_t plt_local_predict(uint32_t pc){
   }
 }
 
-uint8_t plt_perceptron_predict(uint32_t pc){
+uint8_t plt_perceptron_predict(uint64_t pc){
   uint32_t perceptron_entries = 1 << plt_perceptron_table_size;
   
   // Gets the last 16-bits of the PC
@@ -634,7 +759,7 @@ uint8_t plt_perceptron_predict(uint32_t pc){
   return dot_product > 0 ? TAKEN:NOTTAKEN;
 }
 
-uint8_t plt_predict(uint32_t pc){
+uint8_t plt_predict(uint64_t pc){
     // Uses the chooser
     uint8_t local = plt_local_predict(pc);
     uint8_t perceptron = plt_perceptron_predict(pc);
@@ -652,13 +777,34 @@ uint8_t plt_predict(uint32_t pc){
       3: local
     */
     if(plt_pht_chooser[plt_chooser_index] >= 2) {
+      provider = COMP_LOCAL;
       return local;
     } else {
+      provider = COMP_GLOBAL;
       return perceptron;
     }
 }
 
-void train_plt(int32_t pc, uint8_t outcome) {
+// Shift the outcome into the perceptron and chooser global histories and
+// the local history of 'pc'
+static void plt_update_history(uint64_t pc, uint8_t outcome)
+{
+  // Update GHR
+  // perceptron_ghr[0] is alwyas 1
+  for(int i=plt_ghr_width-1;i>0;i--){
+    plt_perceptron_ghr[i] = plt_perceptron_ghr[i-1];
+  }
+  plt_perceptron_ghr[0] = (outcome == TAKEN) ? 1 : -1;
+
+  // Update chooser GHR 
+  plt_chooser_ghr = ((plt_chooser_ghr << 1) | outcome);
+  plt_chooser_ghr = (plt_chooser_ghr) & ((1UL << plt_ghr_width) - 1);
+
+  uint32_t plt_local_index = pc & ((1 << plt_local_pht_width) - 1);
+  plt_bht_local[plt_local_index] = ((plt_bht_local[plt_local_index] << 1) | outcome);
+}
+
+void train_plt(uint64_t pc, uint8_t outcome) {
   uint8_t local = plt_local_predict(pc);
   uint8_t perceptron = plt_perceptron_predict(pc);
   
@@ -667,6 +813,15 @@ void train_plt(int32_t pc, uint8_t outcome) {
   // Using chooser GHR since chooser index in being accessed
   uint32_t plt_chooser_index = plt_chooser_ghr & (chooser_size - 1);
 
+  ALIAS_TOUCH(ALIAS_PLT_CHOOSER, plt_chooser_index, pc,
+              (plt_pht_chooser[plt_chooser_index] >= 2 ? local : perceptron) == outcome);
+
+  if (predictor_stats)
+  {
+    hybrid_update(plt_pht_chooser[plt_chooser_index] >= 2 ? COMP_LOCAL : COMP_GLOBAL,
+                  perceptron == outcome, local == outcome);
+  }
+
   if(local == outcome && perceptron != outcome){
     // Wrap around for 2-bit sat counter
     if(plt_pht_chooser[plt_chooser_index] >= 3){
@@ -694,6 +849,9 @@ void train_plt(int32_t pc, uint8_t outcome) {
   uint16_t current_pattern = plt_bht_local[plt_local_index];
   uint16_t current_pattern_10bits = current_pattern & ((1 << plt_local_pht_width) - 1);
 
+  ALIAS_TOUCH(ALIAS_PLT_LOCAL_BHT, plt_local_index, pc, local == outcome);
+  ALIAS_TOUCH(ALIAS_PLT_LOCAL_PHT, current_pattern_10bits, pc, local == outcome);
+
   // Update state in PHT
   switch (plt_pht_local[current_pattern_10bits])
   {
@@ -722,6 +880,8 @@ void train_plt(int32_t pc, uint8_t outcome) {
   // Gets the last 16-bits of the PC - use as index in Perceptron table
   uint32_t perceptron_table_index = pc & (perceptron_entries - 1);
 
+  ALIAS_TOUCH(ALIAS_PLT_PERCEPTRON, perceptron_table_index, pc, perceptron == outcome);
+
   // Extracting perceptron corresponding to PC
   int current_perc[plt_weight_bias_width];
   for(int i = 0;i<plt_weight_bias_width;i++){
@@ -743,6 +903,12 @@ void train_plt(int32_t pc, uint8_t outcome) {
   int t = (outcome == TAKEN) ? 1:-1; // sstores correct outcome for weight updating
 
   // Updating weight and bias
+  if (predictor_stats)
+  {
+    perceptron_account(&plt_perceptron_stats, dot_product, result_T_NT == outcome,
+                       result_T_NT != outcome || abs(dot_product) <= 37);
+  }
+
   if(result_T_NT != outcome || abs(dot_product) <= 37 ){
 
       int bias = current_perc[0];
@@ -757,23 +923,112 @@ void train_plt(int32_t pc, uint8_t outcome) {
         //Update weight back into actual perceptron table
         plt_perceptron_table[perceptron_table_index][i] = new_weight;
       }
+      if (predictor_stats)
+      {
+        perceptron_track_row(&plt_perceptron_stats, plt_perceptron_table[perceptron_table_index], plt_weight_bias_width);
+      }
   }
 
-  // Update GHR
-  // perceptron_ghr[0] is alwyas 1
-  for(int i=plt_ghr_width-1;i>0;i--){
-    plt_perceptron_ghr[i] = plt_perceptron_ghr[i-1];
+  plt_update_history(pc, outcome);
+}
+
+void cleanup_plt(){
+}
+
+
+// Name of a prediction component of the current predictor type
+//
+const char *provider_name(uint32_t comp)
+{
+  switch (bpType)
+  {
+  case STATIC:
+    return "static";
+  case GSHARE:
+    return "gshare";
+  case TOURNAMENT:
+    return comp == COMP_LOCAL ? "local" : "global";
+  case CUSTOM:
+    return comp == COMP_LOCAL ? "local" : "perceptron";
+  default:
+    return "unknown";
   }
-  plt_perceptron_ghr[0] = (outcome == TAKEN) ? 1 : -1;
+}
 
-  // Update chooser GHR 
-  plt_chooser_ghr = ((plt_chooser_ghr << 1) | outcome);
-  plt_chooser_ghr = (plt_chooser_ghr) & ((1UL << plt_ghr_width) - 1);
+static double per_mille(uint64_t part, uint64_t whole)
+{
+  return whole ? 1000.0 * part / whole : 0.0;
+}
 
-  plt_bht_local[plt_local_index] = ((plt_bht_local[plt_local_index] << 1) | outcome);
+static double percent(uint64_t part, uint64_t whole)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
 
+static void print_perceptron_stats(perceptron_stats_t *st)
+{
+  uint64_t trained = 0;
+  for (int b = 0; b < PERCEPTRON_BUCKETS; b++)
+  {
+    trained += st->histogram[0][b] + st->histogram[1][b];
+  }
+  if (trained == 0)
+  {
+    return;
+  }
+
+  printf("\n%s table:\n", st->name);
+  printf("  Updates: %10" PRIu64 " (%6.2f%% of branches), %" PRIu64 " on mispredictions, %" PRIu64 " below threshold %d\n",
+         st->updates, percent(st->updates, trained), st->updates_mispredicted,
+         st->updates - st->updates_mispredicted, st->threshold);
+  printf("  Weights: min %d, max %d\n", st->min_weight, st->max_weight);
+  printf("  %-9s %10s %10s %7s\n", "|output|", "Correct", "Incorrect", "Miss%");
+  for (int b = 0; b < PERCEPTRON_BUCKETS; b++)
+  {
+    uint64_t right = st->histogram[1][b];
+    uint64_t wrong = st->histogram[0][b];
+    if (right + wrong == 0)
+    {
+      continue;
+    }
+    if (b == PERCEPTRON_BUCKETS - 1)
+    {
+      printf("  %4d+     ", b * PERCEPTRON_BUCKET_WIDTH);
+    }
+    else
+    {
+      printf("  %4d-%-4d ", b * PERCEPTRON_BUCKET_WIDTH, (b + 1) * PERCEPTRON_BUCKET_WIDTH - 1);
+    }
+    printf("%10" PRIu64 " %10" PRIu64 " %7.2f\n", right, wrong, percent(wrong, right + wrong));
+  }
 }
 
+// Print the internal statistics of the current predictor
+//
+void print_predictor_stats(uint64_t num_branches, uint64_t mispredictions)
+{
+  if (bpType == TOURNAMENT || bpType == CUSTOM)
+  {
+    hybrid_stats_t *h = &hybrid_stats;
+    uint64_t oracle_misses = h->predictions - h->oracle_correct;
+
+    printf("\nChooser statistics:\n");
+    for (int c = 0; c < NUM_COMPONENTS; c++)
+    {
+      printf("  %-10s chosen %10" PRIu64 " (%6.2f%%), right when chosen %6.2f%%, right overall %6.2f%%\n",
+             provider_name(c), h->chosen[c], percent(h->chosen[c], h->predictions),
+             percent(h->chosen_correct[c], h->chosen[c]), percent(h->correct[c], h->predictions));
+    }
+    printf("  Oracle chooser incorrect: %10" PRIu64 "  Rate: %7.3f\n",
+           oracle_misses, per_mille(oracle_misses, num_branches));
+    printf("  Chooser regret:           %10" PRIu64 "  Rate: %7.3f  (%.2f%% of mispredictions)\n",
+           h->chooser_wrong, per_mille(h->chooser_wrong, num_branches),
+           percent(h->chooser_wrong, mispredictions));
+  }
+
+  print_perceptron_stats(&perceptron_stats);
+  print_perceptron_stats(&plt_perceptron_stats);
+}
 
 void init_predictor()
 {
@@ -797,12 +1052,95 @@ void init_predictor()
   }
 }
 
+static void add_region(state_region_t *regions, int *n, const char *name, void *data, uint64_t size)
+{
+  regions[*n].name = name;
+  regions[*n].data = data;
+  regions[*n].size = size;
+  regions[*n].config = 0;
+  (*n)++;
+}
+
+static void add_config_region(state_region_t *regions, int *n, const char *name, void *data, uint64_t size)
+{
+  add_region(regions, n, name, data, size);
+  regions[*n - 1].config = 1;
+}
+
+int predictor_state(state_region_t *regions)
+{
+  int n = 0;
+
+  switch (bpType)
+  {
+  case STATIC:
+    break;
+  case GSHARE:
+    add_region(regions, &n, "gshare BHT", bht_gshare, (1 << ghistoryBits) * sizeof(uint8_t));
+    add_region(regions, &n, "gshare GHR", &ghistory, sizeof(ghistory));
+    break;
+  case TOURNAMENT:
+    add_region(regions, &n, "tournament local BHT", tournament_bht_local,
+               (1 << tournament_local_pht_width) * sizeof(uint16_t));
+    add_region(regions, &n, "tournament local PHT", tournament_pht_local,
+               (1 << tournament_local_pht_width) * sizeof(uint8_t));
+    add_region(regions, &n, "tournament global PHT", tournament_pht_global,
+               (1 << tournament_ghr_width) * sizeof(uint8_t));
+    add_region(regions, &n, "tournament chooser", tournament_pht_chooser,
+               (1 << tournament_chooser_width) * sizeof(uint8_t));
+    add_region(regions, &n, "tournament GHR", &tournament_ghr, sizeof(tournament_ghr));
+    break;
+  case CUSTOM:
+    add_region(regions, &n, "PLT perceptron table", plt_perceptron_table, sizeof(plt_perceptron_table));
+    add_region(regions, &n, "PLT perceptron GHR", plt_perceptron_ghr, sizeof(plt_perceptron_ghr));
+    add_region(regions, &n, "PLT local BHT", plt_bht_local, sizeof(plt_bht_local));
+    add_region(regions, &n, "PLT local PHT", plt_pht_local, sizeof(plt_pht_local));
+    add_region(regions, &n, "PLT chooser", plt_pht_chooser, sizeof(plt_pht_chooser));
+    add_region(regions, &n, "PLT chooser GHR", &plt_chooser_ghr, sizeof(plt_chooser_ghr));
+    break;
+  default:
+    break;
+  }
+  if (btb.entries)
+  {
+    add_config_region(regions, &n, "BTB configuration", &btb.config, sizeof(btb.config));
+    add_region(regions, &n, "BTB", btb.entries, (uint64_t)btb.config.sets * btb.config.ways * sizeof(btb_entry_t));
+    add_region(regions, &n, "BTB replacement", &btb.regs, sizeof(btb.regs));
+  }
+  if (ras.stack)
+  {
+    add_config_region(regions, &n, "RAS configuration", &ras.config, sizeof(ras.config));
+    add_region(regions, &n, "RAS", ras.stack, ras.config.depth * sizeof(uint64_t));
+    add_region(regions, &n, "RAS counts", ras.count, ras.config.depth * sizeof(uint32_t));
+    add_region(regions, &n, "RAS pointers", &ras.regs, sizeof(ras.regs));
+  }
+  if (ittage.tables)
+  {
+    add_region(regions, &n, "ITTAGE tables", ittage.tables,
+               (ITTAGE_TABLES << ITTAGE_TABLE_BITS) * sizeof(ittage_entry_t));
+    add_region(regions, &n, "ITTAGE base", ittage.base, (1 << ITTAGE_BASE_BITS) * sizeof(ittage_base_t));
+    add_region(regions, &n, "ITTAGE updates", &ittage.updates, sizeof(ittage.updates));
+    add_region(regions, &n, "global history", &global_history, sizeof(global_history));
+  }
+
+  return n;
+}
+
 // Make a prediction for conditional branch instruction at PC 'pc'
 // Returning TAKEN indicates a prediction of taken; returning NOTTAKEN
 // indicates a prediction of not taken
 //
 uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
 {
+  return make_prediction64(pc, target, direct);
+}
+
+// 64-bit address variant, used by the simulator for every trace
+//
+uint32_t make_prediction64(uint64_t pc, uint64_t target, uint32_t direct)
+{
+  // Single-component predictors, the hybrids override this
+  provider = COMP_GLOBAL;
 
   // Make a prediction based on the bpType
   switch (bpType)
@@ -825,6 +1163,27 @@ uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
   return NOTTAKEN;
 }
 
+// Train the direction predictor of the current type
+//
+static void train_direction(uint64_t pc, uint32_t outcome)
+{
+  switch (bpType)
+  {
+  case STATIC:
+    return;
+  case GSHARE:
+    return train_gshare(pc, outcome);
+  case TOURNAMENT:
+    return train_tournament(pc,outcome);
+  case CUSTOM:
+    //return train_bimodal(pc,outcome);
+    //return train_perceptron(pc,outcome);
+    return train_plt(pc,outcome);
+  default:
+    break;
+  }
+}
+
 // Train the predictor the last executed branch at PC 'pc' and with
 // outcome 'outcome' (true indicates that the branch was taken, false
 // indicates that the branch was not taken)
@@ -832,22 +1191,101 @@ uint32_t make_prediction(uint32_t pc, uint32_t target, uint32_t direct)
 
 void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
 {
-  if (condition)
+  train_predictor64(pc, target, outcome, condition, call, ret, direct);
+}
+
+// 64-bit address variant, used by the simulator for every trace
+//
+void train_predictor64(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct)
+{
+  // Every taken branch, conditional or not, leaves its target in the BTB
+  if (btb.entries && outcome)
   {
-    switch (bpType)
+    btb_update(pc, target);
+  }
+  if (ras.stack)
+  {
+    ras_update(pc, call, ret);
+  }
+  if (ittage.tables)
+  {
+    if (!direct && !ret)
     {
-    case STATIC:
-      return;
-    case GSHARE:
-      return train_gshare(pc, outcome);
-    case TOURNAMENT:
-      return train_tournament(pc,outcome);
-    case CUSTOM:
-      //return train_bimodal(pc,outcome);
-      //return train_perceptron(pc,outcome);
-      return train_plt(pc,outcome);
-    default:
-      break;
+      ittage_update(pc, target);
     }
+    history_update(pc, target, outcome, condition, ret, direct);
+  }
+
+  if (condition && !update_delay)
+  {
+    train_direction(pc, outcome);
+  }
+}
+
+void predictor_history_save(uint64_t pc, history_snapshot_t *h)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    h->global = ghistory;
+    break;
+  case TOURNAMENT:
+    h->global = tournament_ghr;
+    h->local = tournament_bht_local[pc & ((1 << tournament_local_pht_width) - 1)];
+    break;
+  case CUSTOM:
+    h->global = plt_chooser_ghr;
+    h->local = plt_bht_local[pc & ((1 << plt_local_pht_width) - 1)];
+    memcpy(h->perceptron, plt_perceptron_ghr, sizeof(plt_perceptron_ghr));
+    break;
+  default:
+    break;
+  }
+}
+
+void predictor_history_restore(uint64_t pc, const history_snapshot_t *h)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    ghistory = h->global;
+    break;
+  case TOURNAMENT:
+    tournament_ghr = h->global;
+    tournament_bht_local[pc & ((1 << tournament_local_pht_width) - 1)] = h->local;
+    break;
+  case CUSTOM:
+    plt_chooser_ghr = h->global;
+    plt_bht_local[pc & ((1 << plt_local_pht_width) - 1)] = h->local;
+    memcpy(plt_perceptron_ghr, h->perceptron, sizeof(plt_perceptron_ghr));
+    break;
+  default:
+    break;
   }
 }
+
+void predictor_history_update(uint64_t pc, uint32_t outcome)
+{
+  switch (bpType)
+  {
+  case GSHARE:
+    return gshare_update_history(outcome);
+  case TOURNAMENT:
+    return tournament_update_history(pc, outcome);
+  case CUSTOM:
+    return plt_update_history(pc, outcome);
+  default:
+    break;
+  }
+}
+
+void train_predictor_delayed(uint64_t pc, uint32_t outcome, const history_snapshot_t *h)
+{
+  // Train with the histories of the time of the prediction, then go back
+  // to the current ones, which training would have shifted
+  history_snapshot_t current;
+  predictor_history_save(pc, &current);
+  predictor_history_restore(pc, h);
+  train_direction(pc, outcome);
+  predictor_history_restore(pc, &current);
+}
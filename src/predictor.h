@@ -70,6 +70,122 @@ void train_predictor(uint32_t pc, uint32_t target, uint32_t outcome, uint32_t co
 // Please add your code below, and DO NOT MODIFY ANY OF THE CODE ABOVE
 // 
 
+// 64-bit address variants of make_prediction and train_predictor, for
+// traces recorded with full addresses (branchExt -w 64). The simulator
+// calls these for every trace; 32-bit addresses are just zero-extended,
+// so both kinds of trace see exactly the same predictor behavior.
+//
+uint32_t make_prediction64(uint64_t pc, uint64_t target, uint32_t direct);
+void train_predictor64(uint64_t pc, uint64_t target, uint32_t outcome, uint32_t condition, uint32_t call, uint32_t ret, uint32_t direct);
+
+// Prediction components. Hybrid predictors choose between a global
+// history component (tournament global PHT, PLT perceptron) and a local
+// history one; gshare and static only have the global one.
+#define COMP_GLOBAL 0
+#define COMP_LOCAL 1
+#define NUM_COMPONENTS 2
+
+// Component that provided the last make_prediction64 result
+extern uint32_t provider;
+
+// Name of component 'comp' of the current predictor type
+//
+const char *provider_name(uint32_t comp);
+
+// Whether training gathers the chooser and perceptron statistics below
+// (--stats). They are skipped otherwise, so they cost nothing.
+extern int predictor_stats;
+
+// Chooser statistics of the hybrid predictors, gathered while training
+typedef struct
+{
+  uint64_t predictions;
+  uint64_t chosen[NUM_COMPONENTS];         // times the chooser picked each component
+  uint64_t chosen_correct[NUM_COMPONENTS]; // ... and it was right
+  uint64_t correct[NUM_COMPONENTS];        // times each component was right, chosen or not
+  uint64_t oracle_correct;                 // times at least one component was right
+  uint64_t chooser_wrong;                  // chosen component wrong, the other one right
+} hybrid_stats_t;
+
+extern hybrid_stats_t hybrid_stats;
+
+// Histogram of perceptron output magnitudes |dot product|
+#define PERCEPTRON_BUCKET_WIDTH 8
+#define PERCEPTRON_BUCKETS 32 // the last bucket collects everything above
+
+// Training statistics of a perceptron table
+typedef struct
+{
+  const char *name;
+  int threshold;                                  // training threshold on |dot product|
+  uint64_t histogram[2][PERCEPTRON_BUCKETS];      // [correct][|dot product| bucket]
+  uint64_t updates;                               // training events
+  uint64_t updates_mispredicted;                  // ... of which on a misprediction
+  int max_weight;                                 // extremes of bias and weights written
+  int min_weight;
+} perceptron_stats_t;
+
+extern perceptron_stats_t perceptron_stats;
+extern perceptron_stats_t plt_perceptron_stats;
+
+// Print the internal statistics of the current predictor, for a run of
+// 'num_branches' conditional branches with 'mispredictions' in total
+//
+void print_predictor_stats(uint64_t num_branches, uint64_t mispredictions);
+
+// A block of predictor memory: a table, history register or chooser
+typedef struct
+{
+  const char *name;
+  void *data;
+  uint64_t size;
+  int config; // a configuration, compared on load instead of restored
+} state_region_t;
+
+#define MAX_STATE_REGIONS 32
+
+// Fill 'regions' with every table and register that makes up the state
+// of the current (initialized) predictor; returns how many there are
+//
+int predictor_state(state_region_t *regions);
+
+// Conditional branches between the prediction of a branch and the update
+// of the direction tables with its outcome (--update-delay). When it is
+// not 0, train_predictor64 leaves the direction tables to
+// train_predictor_delayed.
+extern int update_delay;
+
+#define MAX_PERCEPTRON_HISTORY 64
+
+// The histories of the current predictor that a prediction of the branch
+// at some PC reads: the global history and the branch's local history
+typedef struct
+{
+  uint64_t global;                            // gshare, tournament or PLT chooser GHR
+  uint16_t local;                             // tournament or PLT local BHT entry
+  int perceptron[MAX_PERCEPTRON_HISTORY];     // PLT perceptron GHR
+} history_snapshot_t;
+
+// Copy the histories the branch at 'pc' is predicted with into 'h'
+//
+void predictor_history_save(uint64_t pc, history_snapshot_t *h);
+
+// Put back histories saved for the branch at 'pc', undoing every history
+// update since
+//
+void predictor_history_restore(uint64_t pc, const history_snapshot_t *h);
+
+// Shift 'outcome' of the branch at 'pc' into the histories, without
+// touching the tables
+//
+void predictor_history_update(uint64_t pc, uint32_t outcome);
+
+// Update the direction tables for the branch at 'pc' with its 'outcome',
+// as they would have been at prediction time with histories 'h'. The
+// current histories are left as they are.
+//
+void train_predictor_delayed(uint64_t pc, uint32_t outcome, const history_snapshot_t *h);
+
 
 
 #endif
@@ -0,0 +1,154 @@
+//========================================================//
+//  profile.cpp                                           //
+//  Source file for the per-branch misprediction profile  //
+//                                                        //
+//  Enabled with --profile, see main.cpp                  //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "profile.h"
+
+// Enough for the static footprint of the bundled traces without growing
+#define PROFILE_INITIAL_BITS 14
+
+profile_t branch_profile;
+
+static void profile_alloc(profile_t *p, int bits)
+{
+  p->capacity = 1ULL << bits;
+  p->shift = 64 - bits;
+  p->used = 0;
+  p->entries = (profile_entry_t *)aligned_alloc(64, p->capacity * sizeof(profile_entry_t));
+  memset(p->entries, 0, p->capacity * sizeof(profile_entry_t));
+}
+
+static profile_entry_t *profile_slot(profile_t *p, uint64_t pc)
+{
+  uint64_t mask = p->capacity - 1;
+  uint64_t slot = (pc * 0x9E3779B97F4A7C15ULL) >> p->shift;
+
+  while (p->entries[slot].executions != 0 && p->entries[slot].pc != pc)
+  {
+    slot = (slot + 1) & mask;
+  }
+  return &p->entries[slot];
+}
+
+// Double the capacity and rehash every entry
+static void profile_grow()
+{
+  profile_t bigger;
+  profile_alloc(&bigger, 64 - branch_profile.shift + 1);
+
+  for (uint64_t i = 0; i < branch_profile.capacity; i++)
+  {
+    if (branch_profile.entries[i].executions != 0)
+    {
+      *profile_slot(&bigger, branch_profile.entries[i].pc) = branch_profile.entries[i];
+      bigger.used++;
+    }
+  }
+
+  free(branch_profile.entries);
+  branch_profile = bigger;
+}
+
+void profile_init()
+{
+  profile_alloc(&branch_profile, PROFILE_INITIAL_BITS);
+}
+
+void profile_update(uint64_t pc, uint32_t outcome, uint32_t prediction, uint32_t comp)
+{
+  profile_entry_t *e = profile_slot(&branch_profile, pc);
+
+  if (e->executions == 0)
+  {
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    if (2 * (branch_profile.used + 1) > branch_profile.capacity)
+    {
+      profile_grow();
+      e = profile_slot(&branch_profile, pc);
+    }
+    e->pc = pc;
+    branch_profile.used++;
+  }
+
+  e->executions++;
+  e->taken += outcome;
+  e->chosen[comp]++;
+  if (prediction != outcome)
+  {
+    e->mispredictions++;
+    e->chosen_wrong[comp]++;
+  }
+}
+
+static int by_mispredictions(const void *a, const void *b)
+{
+  const profile_entry_t *x = *(const profile_entry_t *const *)a;
+  const profile_entry_t *y = *(const profile_entry_t *const *)b;
+  if (x->mispredictions != y->mispredictions)
+  {
+    return x->mispredictions < y->mispredictions ? 1 : -1;
+  }
+  return x->pc < y->pc ? -1 : (x->pc > y->pc);
+}
+
+void profile_report(int top, uint64_t num_branches, uint64_t mispredictions)
+{
+  profile_entry_t **sorted = (profile_entry_t **)malloc(branch_profile.used * sizeof(profile_entry_t *));
+  uint64_t n = 0;
+  for (uint64_t i = 0; i < branch_profile.capacity; i++)
+  {
+    if (branch_profile.entries[i].executions != 0)
+    {
+      sorted[n++] = &branch_profile.entries[i];
+    }
+  }
+  qsort(sorted, n, sizeof(profile_entry_t *), by_mispredictions);
+
+  if ((uint64_t)top > n)
+  {
+    top = n;
+  }
+
+  printf("\nStatic branches: %10" PRIu64 "\n", n);
+  printf("Top %d branches by mispredictions:\n", top);
+  printf("%4s %18s %10s %7s %10s %7s %7s %7s %7s  %s\n", "#", "PC", "Executed", "Taken%",
+         "Incorrect", "Miss%", "Share%", "Cumul%", "Rate", "Provider (chosen%/miss%)");
+
+  uint64_t cumulative = 0;
+  for (int i = 0; i < top; i++)
+  {
+    profile_entry_t *e = sorted[i];
+    cumulative += e->mispredictions;
+    printf("%4d 0x%016" PRIx64 " %10" PRIu64 " %7.2f %10" PRIu64 " %7.2f %7.2f %7.2f %7.3f ",
+           i + 1, e->pc, e->executions,
+           100.0 * e->taken / e->executions,
+           e->mispredictions,
+           100.0 * e->mispredictions / e->executions,
+           mispredictions ? 100.0 * e->mispredictions / mispredictions : 0.0,
+           mispredictions ? 100.0 * cumulative / mispredictions : 0.0,
+           1000.0 * e->mispredictions / num_branches);
+    for (int c = 0; c < NUM_COMPONENTS; c++)
+    {
+      if (e->chosen[c] != 0)
+      {
+        printf(" %s %.1f/%.1f", provider_name(c),
+               100.0 * e->chosen[c] / e->executions,
+               100.0 * e->chosen_wrong[c] / e->chosen[c]);
+      }
+    }
+    printf("\n");
+  }
+
+  free(sorted);
+}
+
+void profile_cleanup()
+{
+  free(branch_profile.entries);
+}
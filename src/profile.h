@@ -0,0 +1,52 @@
+//========================================================//
+//  profile.h                                             //
+//  Header file for the per-branch misprediction profile  //
+//                                                        //
+//  Counts executions and mispredictions of every static  //
+//  conditional branch and reports the hardest ones       //
+//========================================================//
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+#include "predictor.h"
+
+// One static branch. Exactly one cache line, so an update touches a
+// single line of the table.
+typedef struct
+{
+  uint64_t pc;
+  uint64_t executions; // 0 marks an empty slot
+  uint64_t taken;
+  uint64_t mispredictions;
+  uint64_t chosen[NUM_COMPONENTS];       // times each component provided the prediction
+  uint64_t chosen_wrong[NUM_COMPONENTS]; // ... and was wrong
+} __attribute__((aligned(64))) profile_entry_t;
+
+// Open-addressing (linear probing) hash table keyed by PC
+typedef struct
+{
+  profile_entry_t *entries;
+  uint64_t capacity; // power of two
+  uint64_t used;
+  int shift;         // 64 - log2(capacity), for the multiplicative hash
+} profile_t;
+
+// Allocate an empty profile
+//
+void profile_init();
+
+// Record one execution of the conditional branch at 'pc', predicted as
+// 'prediction' by component 'comp'
+//
+void profile_update(uint64_t pc, uint32_t outcome, uint32_t prediction, uint32_t comp);
+
+// Print the 'top' branches with the most mispredictions, out of a run
+// of 'num_branches' conditional branches with 'mispredictions' in total
+//
+void profile_report(int top, uint64_t num_branches, uint64_t mispredictions);
+
+void profile_cleanup();
+
+#endif
@@ -0,0 +1,154 @@
+//========================================================//
+//  ras.cpp                                               //
+//  Source file for the return address stack model        //
+//                                                        //
+//  Enabled with --ras, see main.cpp                      //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "ras.h"
+
+static const char *policy_name[NUM_RAS_POLICIES] = {"circular", "counter"};
+
+// 16 entries, circular
+ras_t ras = {{16, RAS_CIRCULAR}, NULL, NULL, {0, 0}, {0, 0, 0, 0, 0}};
+
+int ras_config(const char *spec)
+{
+  char policy[16] = "";
+  int n = sscanf(spec, "%d:%15s", &ras.config.depth, policy);
+  if (n < 1 || ras.config.depth <= 0)
+  {
+    return 0;
+  }
+  if (n == 2)
+  {
+    for (ras.config.policy = 0; ras.config.policy < NUM_RAS_POLICIES; ras.config.policy++)
+    {
+      if (!strcmp(policy, policy_name[ras.config.policy]))
+      {
+        break;
+      }
+    }
+    return ras.config.policy < NUM_RAS_POLICIES;
+  }
+  return 1;
+}
+
+void ras_init()
+{
+  ras.stack = (uint64_t *)calloc(ras.config.depth, sizeof(uint64_t));
+  ras.count = (uint32_t *)calloc(ras.config.depth, sizeof(uint32_t));
+  memset(&ras.regs, 0, sizeof(ras.regs));
+  memset(&ras.stats, 0, sizeof(ras.stats));
+}
+
+int ras_score(uint64_t target)
+{
+  ras_regs_t *r = &ras.regs;
+  ras.stats.returns++;
+
+  // A circular stack always has something to predict, if only stale
+  if (r->size == 0)
+  {
+    ras.stats.empty++;
+    if (ras.config.policy == RAS_COUNTER)
+    {
+      return 0;
+    }
+  }
+
+  uint64_t call_pc = ras.stack[r->top];
+  int correct = target > call_pc && target - call_pc <= RAS_MAX_CALL_LENGTH;
+  ras.stats.correct += correct;
+  return correct;
+}
+
+static void ras_push(uint64_t pc)
+{
+  ras_regs_t *r = &ras.regs;
+  ras.stats.calls++;
+
+  if (ras.config.policy == RAS_COUNTER)
+  {
+    if (r->size && ras.stack[r->top] == pc && ras.count[r->top] != UINT32_MAX)
+    {
+      ras.count[r->top]++;
+      return;
+    }
+  }
+  if (r->size == (uint64_t)ras.config.depth)
+  {
+    ras.stats.overflows++;
+  }
+
+  r->top = (r->top + 1) % ras.config.depth;
+  ras.stack[r->top] = pc;
+  ras.count[r->top] = 1;
+  if (r->size < (uint64_t)ras.config.depth)
+  {
+    r->size++;
+  }
+}
+
+static void ras_pop()
+{
+  ras_regs_t *r = &ras.regs;
+
+  if (ras.config.policy == RAS_COUNTER && (r->size == 0 || --ras.count[r->top]))
+  {
+    return;
+  }
+
+  // The circular stack wraps around even when empty
+  r->top = (r->top + ras.config.depth - 1) % ras.config.depth;
+  if (r->size)
+  {
+    r->size--;
+  }
+}
+
+void ras_update(uint64_t pc, uint32_t call, uint32_t ret)
+{
+  if (call)
+  {
+    ras_push(pc);
+  }
+  else if (ret)
+  {
+    ras_pop();
+  }
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+  return whole ? 100.0 * part / whole : 0.0;
+}
+
+void ras_report(uint64_t num_branches, uint64_t mispredictions)
+{
+  ras_stats_t *st = &ras.stats;
+  uint64_t wrong = st->returns - st->correct;
+  printf("\nRAS (%d entries, %s):\n", ras.config.depth, policy_name[ras.config.policy]);
+  printf("  Calls:           %10" PRIu64 "\n", st->calls);
+  printf("  Overflows:       %10" PRIu64 "  %6.2f%%\n", st->overflows, percent(st->overflows, st->calls));
+  printf("  Returns:         %10" PRIu64 "\n", st->returns);
+  printf("  Correct:         %10" PRIu64 "  %6.2f%%\n", st->correct, percent(st->correct, st->returns));
+  printf("  Wrong:           %10" PRIu64 "  %6.2f%%\n", wrong, percent(wrong, st->returns));
+  printf("  Empty:           %10" PRIu64 "  %6.2f%%\n", st->empty, percent(st->empty, st->returns));
+  printf("  Direction accuracy: %6.2f%%, return accuracy: %6.2f%%\n",
+         100.0 - percent(mispredictions, num_branches), percent(st->correct, st->returns));
+  printf("  Mispredictions per 1000 conditional branches: %.3f direction + %.3f return\n",
+         num_branches ? 1000.0 * mispredictions / num_branches : 0.0,
+         num_branches ? 1000.0 * wrong / num_branches : 0.0);
+}
+
+void ras_cleanup()
+{
+  free(ras.stack);
+  free(ras.count);
+  ras.stack = NULL;
+  ras.count = NULL;
+}
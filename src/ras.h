@@ -0,0 +1,90 @@
+//========================================================//
+//  ras.h                                                 //
+//  Header file for the return address stack model        //
+//                                                        //
+//  Pushed by call records and popped by return records,  //
+//  and checked against the return targets of the trace   //
+//========================================================//
+
+#ifndef RAS_H
+#define RAS_H
+
+#include <stdint.h>
+
+// Overflow and underflow policies
+enum
+{
+  RAS_CIRCULAR, // a full stack overwrites its oldest entry, an empty one
+                // predicts whatever it held last
+  RAS_COUNTER,  // recursive calls share an entry with a repeat count,
+                // a full stack also overwrites its oldest entry, and an
+                // empty one predicts nothing
+  NUM_RAS_POLICIES
+};
+
+// Traces only carry the call's own PC, not its length. A return is
+// predicted right if its target is the fall-through of the predicted call,
+// 1 to RAS_MAX_CALL_LENGTH bytes past it (the longest x86 instruction).
+#define RAS_MAX_CALL_LENGTH 15
+
+typedef struct
+{
+  uint64_t top;  // index of the top entry
+  uint64_t size; // entries in use
+} ras_regs_t;
+
+typedef struct
+{
+  uint64_t calls;
+  uint64_t returns;
+  uint64_t correct;
+  uint64_t empty;     // returns with nothing to predict
+  uint64_t overflows; // calls that overwrote an entry
+} ras_stats_t;
+
+// Shape of the RAS. Saved in snapshots, which only load into a RAS
+// configured the same way.
+typedef struct
+{
+  int32_t depth;
+  int32_t policy;
+} ras_config_t;
+
+typedef struct
+{
+  ras_config_t config;
+  uint64_t *stack; // call PCs, NULL when the RAS is off
+  uint32_t *count; // repeat counts of the entries (RAS_COUNTER)
+  ras_regs_t regs;
+  ras_stats_t stats;
+} ras_t;
+
+extern ras_t ras;
+
+// Parse a --ras configuration DEPTH[:circular|counter]. Returns 0 if it
+// is malformed.
+//
+int ras_config(const char *spec);
+
+// Allocate the configured RAS, empty
+//
+void ras_init();
+
+// Predict the return at the top of the stack, without popping it, and
+// score it against its actual 'target'. Returns whether it was right.
+//
+int ras_score(uint64_t target);
+
+// Push the call at 'pc', or pop for a return
+//
+void ras_update(uint64_t pc, uint32_t call, uint32_t ret);
+
+// Print the RAS statistics gathered since ras_init, next to the
+// 'mispredictions' of the direction predictor over 'num_branches'
+// conditional branches of the same stretch of the trace
+//
+void ras_report(uint64_t num_branches, uint64_t mispredictions);
+
+void ras_cleanup();
+
+#endif
@@ -0,0 +1,293 @@
+//========================================================//
+//  simpoint.cpp                                          //
+//  Source file for representative-interval sampling      //
+//                                                        //
+//  Enabled with --simpoint, see main.cpp                 //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include "parallel.h"
+#include "simpoint.h"
+
+#define KMEANS_ITERATIONS 100
+
+typedef struct
+{
+  double v[SIMPOINT_DIMS];
+} simpoint_vector_t;
+
+static double distance(const simpoint_vector_t *a, const simpoint_vector_t *b)
+{
+  double d = 0.0;
+  for (int i = 0; i < SIMPOINT_DIMS; i++)
+  {
+    d += (a->v[i] - b->v[i]) * (a->v[i] - b->v[i]);
+  }
+  return d;
+}
+
+// Cluster the 'n' vectors into 'k' groups; 'cluster' receives the group
+// of every vector and 'centroid' the centre of every group. The initial
+// centres are picked farthest-first from vector 0, so the result is
+// deterministic.
+static void kmeans(const simpoint_vector_t *vectors, int n, int k, int *cluster, simpoint_vector_t *centroid)
+{
+  double *nearest = (double *)malloc(n * sizeof(double));
+  centroid[0] = vectors[0];
+  for (int i = 0; i < n; i++)
+  {
+    nearest[i] = distance(&vectors[i], &centroid[0]);
+  }
+  for (int c = 1; c < k; c++)
+  {
+    int farthest = 0;
+    for (int i = 1; i < n; i++)
+    {
+      if (nearest[i] > nearest[farthest])
+      {
+        farthest = i;
+      }
+    }
+    centroid[c] = vectors[farthest];
+    for (int i = 0; i < n; i++)
+    {
+      double d = distance(&vectors[i], &centroid[c]);
+      nearest[i] = d < nearest[i] ? d : nearest[i];
+    }
+  }
+  free(nearest);
+
+  int *size = (int *)malloc(k * sizeof(int));
+  for (int i = 0; i < n; i++)
+  {
+    cluster[i] = -1;
+  }
+  for (int iteration = 0; iteration < KMEANS_ITERATIONS; iteration++)
+  {
+    int changed = 0;
+    for (int i = 0; i < n; i++)
+    {
+      int best = 0;
+      double best_d = distance(&vectors[i], &centroid[0]);
+      for (int c = 1; c < k; c++)
+      {
+        double d = distance(&vectors[i], &centroid[c]);
+        if (d < best_d)
+        {
+          best = c;
+          best_d = d;
+        }
+      }
+      changed += cluster[i] != best;
+      cluster[i] = best;
+    }
+    if (!changed)
+    {
+      break;
+    }
+
+    memset(size, 0, k * sizeof(int));
+    memset(centroid, 0, k * sizeof(simpoint_vector_t));
+    for (int i = 0; i < n; i++)
+    {
+      size[cluster[i]]++;
+      for (int d = 0; d < SIMPOINT_DIMS; d++)
+      {
+        centroid[cluster[i]].v[d] += vectors[i].v[d];
+      }
+    }
+    for (int c = 0; c < k; c++)
+    {
+      for (int d = 0; d < SIMPOINT_DIMS; d++)
+      {
+        centroid[c].v[d] /= size[c] ? size[c] : 1;
+      }
+    }
+  }
+  free(size);
+}
+
+static double rate(const sim_range_t *r)
+{
+  return r->num_branches ? (double)r->mispredictions / r->num_branches : 0.0;
+}
+
+int simpoint_run(const trace_t *trace, uint64_t interval, int k, uint64_t warmup, int exact,
+                 uint64_t *num_branches, uint64_t *mispredictions)
+{
+  int n = (trace->num_branches + interval - 1) / interval;
+  k = k < n ? k : n;
+
+  // Frequency vector and first record of every interval
+  simpoint_vector_t *vectors = (simpoint_vector_t *)calloc(n, sizeof(simpoint_vector_t));
+  uint64_t *first = (uint64_t *)malloc((n + 1) * sizeof(uint64_t));
+  uint64_t branch = 0;
+  for (uint64_t i = 0; i < trace->num_records; i++)
+  {
+    const trace_record_t *r = &trace->records[i];
+    if (r->condition != 1)
+    {
+      continue;
+    }
+    if (branch % interval == 0)
+    {
+      first[branch / interval] = branch ? i : 0;
+    }
+    uint64_t dim = (r->pc * 0x9e3779b97f4a7c15ULL) >> 58;
+    vectors[branch / interval].v[dim % SIMPOINT_DIMS] += 1.0;
+    branch++;
+  }
+  first[n] = trace->num_records;
+  for (int j = 0; j < n; j++)
+  {
+    double total = 0.0;
+    for (int d = 0; d < SIMPOINT_DIMS; d++)
+    {
+      total += vectors[j].v[d];
+    }
+    for (int d = 0; d < SIMPOINT_DIMS; d++)
+    {
+      vectors[j].v[d] /= total;
+    }
+  }
+
+  int *cluster = (int *)malloc(n * sizeof(int));
+  simpoint_vector_t *centroid = (simpoint_vector_t *)malloc(k * sizeof(simpoint_vector_t));
+  kmeans(vectors, n, k, cluster, centroid);
+
+  // Per cluster: its weight in branches, the member nearest to the centre
+  // as representative and another member to estimate the spread
+  uint64_t *weight = (uint64_t *)calloc(k, sizeof(uint64_t));
+  int *rep = (int *)malloc(k * sizeof(int));
+  int *check = (int *)malloc(k * sizeof(int));
+  for (int c = 0; c < k; c++)
+  {
+    rep[c] = check[c] = -1;
+  }
+  for (int j = 0; j < n; j++)
+  {
+    int c = cluster[j];
+    weight[c] += (j + 1 < n ? interval : trace->num_branches - (uint64_t)j * interval);
+    if (rep[c] < 0 || distance(&vectors[j], &centroid[c]) < distance(&vectors[rep[c]], &centroid[c]))
+    {
+      rep[c] = j;
+    }
+  }
+  for (int c = 0; c < k; c++)
+  {
+    // The middle one, in trace order, of the other members
+    int others = 0, seen = 0;
+    for (int j = 0; j < n; j++)
+    {
+      others += cluster[j] == c && j != rep[c];
+    }
+    for (int j = 0; j < n && check[c] < 0; j++)
+    {
+      if (cluster[j] == c && j != rep[c] && seen++ == (others - 1) / 2)
+      {
+        check[c] = j;
+      }
+    }
+  }
+
+  // Ranges to simulate: the representatives and the check members of every
+  // cluster, then the exact whole-trace run
+  sim_range_t *ranges = (sim_range_t *)calloc(2 * k + 1, sizeof(sim_range_t));
+  int *range_of = (int *)malloc(2 * k * sizeof(int)); // [rep of every cluster, check of every cluster]
+  int num_ranges = 0;
+  uint64_t simulated = 0;
+  for (int i = 0; i < 2 * k; i++)
+  {
+    int j = i < k ? rep[i] : check[i - k];
+    range_of[i] = j < 0 ? -1 : num_ranges;
+    if (j < 0)
+    {
+      continue;
+    }
+    uint64_t start_branch = (uint64_t)j * interval;
+    uint64_t warm_branch = start_branch > warmup ? start_branch - warmup : 0;
+    sim_range_t *r = &ranges[num_ranges++];
+    r->warm = warm_branch ? trace_find_branch(trace, warm_branch) : 0;
+    r->start = first[j];
+    r->end = first[j + 1];
+    simulated += start_branch - warm_branch + (j + 1 < n ? interval : trace->num_branches - start_branch);
+  }
+  sim_range_t *sequential = &ranges[num_ranges];
+  if (exact)
+  {
+    sequential->end = trace->num_records;
+  }
+
+  int ok = simulate_ranges(trace, ranges, num_ranges + (exact != 0));
+
+  // Stratified estimate: every cluster contributes its weight times the
+  // misprediction rate of its representative. The spread between the
+  // representative and the check member of a cluster estimates the
+  // variance of that stratum; single-interval clusters are exact.
+  double estimate = 0.0, variance = 0.0;
+  for (int c = 0; c < k; c++)
+  {
+    if (range_of[c] < 0)
+    {
+      continue; // empty cluster
+    }
+    double w = (double)weight[c];
+    estimate += w * rate(&ranges[range_of[c]]);
+    if (range_of[k + c] >= 0)
+    {
+      double spread = rate(&ranges[range_of[c]]) - rate(&ranges[range_of[k + c]]);
+      variance += w * w * spread * spread / 2;
+    }
+  }
+  double B = (double)trace->num_branches;
+  double error = sqrt(variance);
+
+  if (ok)
+  {
+    printf("SimPoint sampling: %d intervals of %" PRIu64 " branches, %d clusters, warm-up %" PRIu64 " branches\n",
+           n, interval, k, warmup);
+    printf("  %-8s %8s %10s %10s %10s\n", "Cluster", "Weight%", "Interval", "Rate", "Check");
+    for (int c = 0; c < k; c++)
+    {
+      if (range_of[c] < 0)
+      {
+        continue;
+      }
+      printf("  %-8d %8.2f %10d %10.3f", c, 100.0 * weight[c] / B, rep[c], 1000.0 * rate(&ranges[range_of[c]]));
+      if (range_of[k + c] >= 0)
+      {
+        printf(" %10.3f\n", 1000.0 * rate(&ranges[range_of[k + c]]));
+      }
+      else
+      {
+        printf(" %10s\n", "-");
+      }
+    }
+    printf("  Simulated branches:   %10" PRIu64 " (%.2f%% of the trace, warm-up included)\n",
+           simulated, 100.0 * simulated / B);
+    printf("  Estimated rate:       %10.3f +/- %.3f\n", 1000.0 * estimate / B, 1000.0 * error / B);
+    if (exact)
+    {
+      printf("  Sequential rate:      %10.3f (estimate off by %+.3f%%)\n", 1000.0 * rate(sequential),
+             sequential->mispredictions ? 100.0 * (estimate - sequential->mispredictions) / sequential->mispredictions : 0.0);
+    }
+    printf("\n");
+  }
+
+  *num_branches = trace->num_branches;
+  *mispredictions = (uint64_t)(estimate + 0.5);
+
+  free(vectors);
+  free(first);
+  free(cluster);
+  free(centroid);
+  free(weight);
+  free(rep);
+  free(check);
+  free(ranges);
+  free(range_of);
+  return ok;
+}
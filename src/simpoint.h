@@ -0,0 +1,31 @@
+//========================================================//
+//  simpoint.h                                            //
+//  Header file for representative-interval sampling      //
+//                                                        //
+//  SimPoint-style: clusters the intervals of a trace by  //
+//  their branch PC frequencies and simulates only one    //
+//  representative interval per cluster                   //
+//========================================================//
+
+#ifndef SIMPOINT_H
+#define SIMPOINT_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// Dimensions of the interval frequency vectors, branch PCs are hashed
+// into them
+#define SIMPOINT_DIMS 32
+
+// Estimate the mispredictions of the current predictor type over 'trace'
+// by splitting it into intervals of 'interval' conditional branches,
+// grouping them into up to 'k' clusters and simulating one representative
+// per cluster after 'warmup' branches of warm-up. A second member of
+// every cluster is simulated too, to estimate the error. With 'exact' the
+// whole trace is also simulated to report the actual error. Returns the
+// trace's branch count and estimated mispredictions; 0 if a worker failed.
+//
+int simpoint_run(const trace_t *trace, uint64_t interval, int k, uint64_t warmup, int exact,
+                 uint64_t *num_branches, uint64_t *mispredictions);
+
+#endif
@@ -0,0 +1,172 @@
+//========================================================//
+//  state.cpp                                             //
+//  Source file for predictor state snapshots             //
+//                                                        //
+//  Enabled with --save-state/--load-state, see main.cpp  //
+//========================================================//
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "predictor.h"
+#include "state.h"
+
+// A snapshot is a header, a directory of the predictor's regions and the
+// regions themselves, each at a page-aligned offset so the file can be
+// mapped and every table used in place.
+#define STATE_MAGIC "BPSTATE"
+#define STATE_ALIGN 4096
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t bp_type;
+  int32_t ghistory_bits;
+  uint32_t num_regions;
+  state_position_t pos;
+} state_header_t;
+
+typedef struct
+{
+  char name[48];
+  uint64_t offset;
+  uint64_t size;
+} state_entry_t;
+
+static uint64_t align_up(uint64_t offset)
+{
+  return (offset + STATE_ALIGN - 1) & ~(uint64_t)(STATE_ALIGN - 1);
+}
+
+int state_save(const char *path, const state_position_t *pos)
+{
+  state_region_t regions[MAX_STATE_REGIONS];
+  int n = predictor_state(regions);
+
+  state_header_t header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, STATE_MAGIC);
+  header.version = STATE_VERSION;
+  header.bp_type = bpType;
+  header.ghistory_bits = ghistoryBits;
+  header.num_regions = n;
+  header.pos = *pos;
+
+  state_entry_t entries[MAX_STATE_REGIONS];
+  memset(entries, 0, sizeof(entries));
+  uint64_t offset = align_up(sizeof(header) + n * sizeof(state_entry_t));
+  for (int i = 0; i < n; i++)
+  {
+    strncpy(entries[i].name, regions[i].name, sizeof(entries[i].name) - 1);
+    entries[i].offset = offset;
+    entries[i].size = regions[i].size;
+    offset = align_up(offset + regions[i].size);
+  }
+
+  // Written to a temporary file and renamed, so an interrupted save never
+  // leaves a truncated snapshot behind
+  char tmp_path[4096];
+  snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+  FILE *f = fopen(tmp_path, "wb");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  int ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+           fwrite(entries, sizeof(state_entry_t), n, f) == (size_t)n;
+  for (int i = 0; i < n && ok; i++)
+  {
+    ok = fseek(f, entries[i].offset, SEEK_SET) == 0 &&
+         fwrite(regions[i].data, 1, regions[i].size, f) == regions[i].size;
+  }
+  ok = (fclose(f) == 0) && ok;
+
+  if (!ok || rename(tmp_path, path) != 0)
+  {
+    unlink(tmp_path);
+    return 0;
+  }
+  return 1;
+}
+
+int state_load(const char *path, state_position_t *pos)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+  {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 0;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(state_header_t))
+  {
+    fprintf(stderr, "%s is not a predictor snapshot\n", path);
+    close(fd);
+    return 0;
+  }
+  const char *map = (const char *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    fprintf(stderr, "Unable to map %s\n", path);
+    return 0;
+  }
+
+  int ok = 0;
+  const state_header_t *header = (const state_header_t *)map;
+  const state_entry_t *entries = (const state_entry_t *)(header + 1);
+  state_region_t regions[MAX_STATE_REGIONS];
+  int n = predictor_state(regions);
+
+  if (memcmp(header->magic, STATE_MAGIC, sizeof(header->magic)))
+  {
+    fprintf(stderr, "%s is not a predictor snapshot\n", path);
+  }
+  else if (header->version != STATE_VERSION)
+  {
+    fprintf(stderr, "%s is a version %u snapshot, expected version %d\n", path, header->version, STATE_VERSION);
+  }
+  else if (header->bp_type != (uint32_t)bpType || header->ghistory_bits != ghistoryBits ||
+           header->num_regions != (uint32_t)n)
+  {
+    fprintf(stderr, "%s is a snapshot of another predictor (%s:%d)\n", path,
+            header->bp_type < 4 ? bpName[header->bp_type] : "?", header->ghistory_bits);
+  }
+  else if ((uint64_t)st.st_size < sizeof(state_header_t) + n * sizeof(state_entry_t))
+  {
+    fprintf(stderr, "%s is truncated\n", path);
+  }
+  else
+  {
+    ok = 1;
+    for (int i = 0; i < n && ok; i++)
+    {
+      const state_entry_t *e = &entries[i];
+      ok = !strncmp(e->name, regions[i].name, sizeof(e->name)) && e->size == regions[i].size &&
+           e->offset <= (uint64_t)st.st_size && e->size <= (uint64_t)st.st_size - e->offset;
+      if (!ok)
+      {
+        fprintf(stderr, "%s: region %s does not match the predictor\n", path, regions[i].name);
+      }
+      else if (regions[i].config && memcmp(regions[i].data, map + e->offset, e->size))
+      {
+        fprintf(stderr, "%s was saved with another %s\n", path, regions[i].name);
+        ok = 0;
+      }
+    }
+    for (int i = 0; i < n && ok; i++)
+    {
+      if (!regions[i].config)
+      {
+        memcpy(regions[i].data, map + entries[i].offset, regions[i].size);
+      }
+    }
+    *pos = header->pos;
+  }
+
+  munmap((void *)map, st.st_size);
+  return ok;
+}
@@ -0,0 +1,38 @@
+//========================================================//
+//  state.h                                               //
+//  Header file for predictor state snapshots             //
+//                                                        //
+//  Saves the tables and history registers of a warmed-up //
+//  predictor, to resume a run without replaying it       //
+//========================================================//
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <stdint.h>
+
+// Bumped whenever the layout of a snapshot or of a predictor's state
+// changes; older snapshots are then refused
+#define STATE_VERSION 3
+
+// Position in the trace a snapshot was taken at
+typedef struct
+{
+  uint64_t records;        // trace records consumed, conditional or not
+  uint64_t num_branches;   // conditional branches simulated
+  uint64_t mispredictions;
+} state_position_t;
+
+// Write the state of the current predictor, taken at 'pos', to 'path'.
+// Returns 0 on failure.
+//
+int state_save(const char *path, const state_position_t *pos);
+
+// Restore the state of the current predictor, already initialized, from
+// the snapshot 'path' and return where it was taken in 'pos'. Fails,
+// returning 0, if the snapshot is of another version, predictor type or
+// configuration.
+//
+int state_load(const char *path, state_position_t *pos);
+
+#endif
@@ -0,0 +1,63 @@
+//========================================================//
+//  timing.cpp                                            //
+//  Source file for the simulator self-profiling          //
+//                                                        //
+//  Enabled with --timing, see main.cpp                   //
+//========================================================//
+#include <stdio.h>
+#include <inttypes.h>
+#include "timing.h"
+
+timing_t timing;
+
+static const char *stage_name[NUM_STAGES] = {"read", "predict", "train", "output"};
+
+void timing_start()
+{
+  // Every mark includes one clock read, the one ending the stage
+  uint64_t total = 0;
+  for (int i = 0; i < TIMING_CALIBRATION_PAIRS; i++)
+  {
+    uint64_t start = timing_now();
+    total += timing_now() - start;
+  }
+  timing.overhead_ns = (double)total / TIMING_CALIBRATION_PAIRS;
+  timing.rng = 0x9e3779b97f4a7c15ULL;
+  timing.start_ns = timing_now();
+}
+
+// Time spent in 'stage' over the sampled records, less the clock overhead
+static double stage_time(int stage)
+{
+  double ns = timing.stage_ns[stage] - timing.marks[stage] * timing.overhead_ns;
+  return ns > 0 ? ns : 0.0;
+}
+
+void timing_report(uint64_t records, uint64_t num_branches)
+{
+  double wall_ns = (double)(timing_now() - timing.start_ns);
+  double scale = timing.sampled ? (double)records / timing.sampled : 0.0;
+
+  double sampled_ns = 0;
+  for (int i = 0; i < NUM_STAGES; i++)
+  {
+    sampled_ns += stage_time(i);
+  }
+
+  printf("\nTiming (%" PRIu64 " records sampled, %.1f ns clock overhead per stage removed):\n",
+         timing.sampled, timing.overhead_ns);
+  printf("  %-8s %12s %12s %7s\n", "Stage", "ns/record", "ns/branch", "Share%");
+  for (int i = 0; i < NUM_STAGES; i++)
+  {
+    double total_ns = stage_time(i) * scale;
+    printf("  %-8s %12.1f %12.1f %7.2f\n", stage_name[i],
+           records ? total_ns / records : 0.0,
+           num_branches ? total_ns / num_branches : 0.0,
+           sampled_ns ? 100.0 * stage_time(i) / sampled_ns : 0.0);
+  }
+  printf("  Stages total:     %10.3f s  %6.2f%% of wall time\n", sampled_ns * scale / 1e9,
+         wall_ns ? 100.0 * sampled_ns * scale / wall_ns : 0.0);
+  printf("  Wall time:        %10.3f s\n", wall_ns / 1e9);
+  printf("  Records/sec:      %10.0f\n", records / (wall_ns / 1e9));
+  printf("  Branches/sec:     %10.0f\n", num_branches / (wall_ns / 1e9));
+}
@@ -0,0 +1,89 @@
+//========================================================//
+//  timing.h                                              //
+//  Header file for the simulator self-profiling          //
+//                                                        //
+//  Splits the time of the simulation loop into stages,   //
+//  timing one in TIMING_SAMPLE_PERIOD records on average //
+//========================================================//
+
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <time.h>
+
+// Stages of the simulation loop
+enum
+{
+  STAGE_READ,    // read_branch
+  STAGE_PREDICT, // make_prediction and scoring
+  STAGE_TRAIN,   // train_predictor
+  STAGE_OUTPUT,  // --verbose printing and statistics collection
+  NUM_STAGES
+};
+
+// Time one record out of this many on average (power of two). Records
+// are picked at random so the samples do not line up with periodic work
+// such as the block decoding of a container trace.
+#define TIMING_SAMPLE_PERIOD 16
+
+// Empty timing_now pairs timed at start to calibrate the clock overhead
+#define TIMING_CALIBRATION_PAIRS 1000
+
+typedef struct
+{
+  uint64_t stage_ns[NUM_STAGES]; // summed over the sampled records
+  uint64_t marks[NUM_STAGES];    // times each stage was timed
+  uint64_t sampled;              // records timed
+  double overhead_ns;            // clock read cost included in each mark
+  uint64_t rng;                  // picks the sampled records
+  uint64_t last_ns;              // end of the previous stage
+  uint64_t start_ns;             // start of the whole run
+} timing_t;
+
+extern timing_t timing;
+
+static inline uint64_t timing_now()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Whether the next record is one of the timed ones; if so starts its
+// first stage
+//
+static inline int timing_sample()
+{
+  timing.rng ^= timing.rng << 13;
+  timing.rng ^= timing.rng >> 7;
+  timing.rng ^= timing.rng << 17;
+  if ((timing.rng >> 32) & (TIMING_SAMPLE_PERIOD - 1))
+  {
+    return 0;
+  }
+  timing.sampled++;
+  timing.last_ns = timing_now();
+  return 1;
+}
+
+// End 'stage' of the current timed record, starting the next one
+//
+static inline void timing_mark(int stage)
+{
+  uint64_t now = timing_now();
+  timing.stage_ns[stage] += now - timing.last_ns;
+  timing.marks[stage]++;
+  timing.last_ns = now;
+}
+
+// Calibrate the clock overhead and start the wall clock of the run
+//
+void timing_start();
+
+// Print the per-stage breakdown of a run over 'records' trace records,
+// 'num_branches' of them conditional
+//
+void timing_report(uint64_t records, uint64_t num_branches);
+
+#endif
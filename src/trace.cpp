@@ -0,0 +1,83 @@
+//========================================================//
+//  trace.cpp                                             //
+//  Source file for in-memory traces                      //
+//========================================================//
+#include <stdlib.h>
+#include <inttypes.h>
+#include "trace.h"
+
+void trace_parse_line(const char *line, trace_record_t *record)
+{
+  uint64_t pc = record->pc, target = record->target;
+  uint32_t outcome = record->outcome, condition = record->condition, call = record->call;
+  uint32_t ret = record->ret, direct = record->direct;
+
+  sscanf(line, "0x%" SCNx64 "\t0x%" SCNx64 "\t%d\t%d\t%d\t%d\t%d\n", &pc, &target, &outcome, &condition, &call, &ret, &direct);
+
+  record->pc = pc;
+  record->target = target;
+  record->outcome = outcome;
+  record->condition = condition;
+  record->call = call;
+  record->ret = ret;
+  record->direct = direct;
+}
+
+int trace_load(FILE *stream, trace_t *trace)
+{
+  char *buf = NULL;
+  size_t len = 0;
+  uint64_t capacity = 1 << 20;
+
+  trace->records = (trace_record_t *)malloc(capacity * sizeof(trace_record_t));
+  trace->num_records = 0;
+  trace->num_branches = 0;
+  if (trace->records == NULL)
+  {
+    return 0;
+  }
+
+  trace_record_t last = {0, 0, 0, 0, 0, 0, 0};
+  while (getline(&buf, &len, stream) != -1)
+  {
+    trace_parse_line(buf, &last);
+
+    if (trace->num_records == capacity)
+    {
+      capacity *= 2;
+      trace_record_t *grown = (trace_record_t *)realloc(trace->records, capacity * sizeof(trace_record_t));
+      if (grown == NULL)
+      {
+        free(buf);
+        return 0;
+      }
+      trace->records = grown;
+    }
+
+    trace->records[trace->num_records++] = last;
+    trace->num_branches += (last.condition == 1);
+  }
+
+  free(buf);
+  return 1;
+}
+
+void trace_free(trace_t *trace)
+{
+  free(trace->records);
+  trace->records = NULL;
+  trace->num_records = trace->num_branches = 0;
+}
+
+uint64_t trace_find_branch(const trace_t *trace, uint64_t branch)
+{
+  uint64_t seen = 0;
+  for (uint64_t i = 0; i < trace->num_records; i++)
+  {
+    if (trace->records[i].condition == 1 && seen++ == branch)
+    {
+      return i;
+    }
+  }
+  return trace->num_records;
+}
@@ -0,0 +1,51 @@
+//========================================================//
+//  trace.h                                               //
+//  Header file for in-memory traces                      //
+//                                                        //
+//  Decoded trace records, for the modes that need random //
+//  access to the whole trace                             //
+//========================================================//
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+// One decoded line of a trace
+typedef struct
+{
+  uint64_t pc;
+  uint64_t target;
+  uint8_t outcome;
+  uint8_t condition;
+  uint8_t call;
+  uint8_t ret;
+  uint8_t direct;
+} trace_record_t;
+
+typedef struct
+{
+  trace_record_t *records;
+  uint64_t num_records;
+  uint64_t num_branches; // conditional records
+} trace_t;
+
+// Decode one line of a text trace into 'record'. Like read_branch in
+// main.cpp, fields missing from a malformed line keep their old values.
+//
+void trace_parse_line(const char *line, trace_record_t *record);
+
+// Read and decode every remaining line of 'stream'. Returns 0 if out of
+// memory.
+//
+int trace_load(FILE *stream, trace_t *trace);
+
+void trace_free(trace_t *trace);
+
+// Index of the record holding conditional branch number 'branch' (counting
+// from 0), or num_records if the trace has fewer branches
+//
+uint64_t trace_find_branch(const trace_t *trace, uint64_t branch);
+
+#endif
@@ -0,0 +1,304 @@
+//========================================================//
+//  tracecache.cpp                                        //
+//  Source file for the decoded trace cache               //
+//                                                        //
+//  Enabled with --cache, see main.cpp                    //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <bzlib.h>
+#include "tracecache.h"
+
+// An image is a header followed, at a page boundary, by the trace_record_t
+// array itself, so mapped records are used in place without any copy.
+#define TRACECACHE_MAGIC "BPCACHE"
+#define TRACECACHE_VERSION 1
+#define TRACECACHE_RECORDS_OFFSET 4096
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t key;
+  uint64_t num_records;
+  uint64_t num_branches;
+} tracecache_header_t;
+
+// Hash of the bytes of the trace file, 8 at a time
+static int hash_file(const char *path, uint64_t *key)
+{
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  uint64_t h = 0x9e3779b97f4a7c15ULL;
+  uint64_t words[4096];
+  size_t n;
+  while ((n = fread(words, 1, sizeof(words), f)) > 0)
+  {
+    if (n % 8)
+    {
+      memset((char *)words + n, 0, 8 - n % 8);
+    }
+    for (size_t i = 0; i < (n + 7) / 8; i++)
+    {
+      h = (h ^ words[i]) * 0xff51afd7ed558ccdULL;
+      h ^= h >> 32;
+    }
+    h ^= n;
+  }
+  fclose(f);
+  *key = h;
+  return 1;
+}
+
+// Lines of a text or bzip2-compressed trace file, the latter possibly made
+// of several concatenated streams (pbzip2)
+typedef struct
+{
+  FILE *f;
+  BZFILE *bz;
+  char data[1 << 16];
+  size_t start;
+  size_t end;
+  int eof;
+  int error; // the file could not be read or decompressed to its end
+} line_reader_t;
+
+static size_t reader_fill(line_reader_t *r, char *dst, size_t size)
+{
+  if (r->bz == NULL)
+  {
+    size_t n = fread(dst, 1, size, r->f);
+    r->error = ferror(r->f);
+    return n;
+  }
+  for (;;)
+  {
+    int error;
+    int n = BZ2_bzRead(&error, r->bz, dst, size);
+    if (error == BZ_OK && n > 0)
+    {
+      return n;
+    }
+    if (error != BZ_STREAM_END && error != BZ_OK)
+    {
+      // Corrupt or truncated (BZ_UNEXPECTED_EOF)
+      r->error = 1;
+      return 0;
+    }
+
+    // End of one stream: carry on with the next, if any
+    void *unused;
+    int num_unused;
+    char rest[BZ_MAX_UNUSED];
+    BZ2_bzReadGetUnused(&error, r->bz, &unused, &num_unused);
+    memcpy(rest, unused, num_unused);
+    BZ2_bzReadClose(&error, r->bz);
+    r->bz = NULL;
+    if (num_unused == 0 && feof(r->f))
+    {
+      return n > 0 ? n : 0;
+    }
+    r->bz = BZ2_bzReadOpen(&error, r->f, 0, 0, rest, num_unused);
+    if (error != BZ_OK)
+    {
+      r->bz = NULL;
+      r->error = 1;
+      return 0;
+    }
+    if (n > 0)
+    {
+      return n;
+    }
+  }
+}
+
+// Next line, NUL-terminated in place; NULL at the end of the file
+static char *reader_line(line_reader_t *r)
+{
+  for (;;)
+  {
+    char *nl = (char *)memchr(r->data + r->start, '\n', r->end - r->start);
+    if (nl != NULL || (r->eof && r->start < r->end))
+    {
+      char *line = r->data + r->start;
+      if (nl == NULL)
+      {
+        nl = r->data + r->end;
+      }
+      *nl = '\0';
+      r->start = nl - r->data + 1;
+      if (r->start > r->end)
+      {
+        r->start = r->end;
+      }
+      return line;
+    }
+    if (r->eof)
+    {
+      return NULL;
+    }
+    memmove(r->data, r->data + r->start, r->end - r->start);
+    r->end -= r->start;
+    r->start = 0;
+    size_t n = reader_fill(r, r->data + r->end, sizeof(r->data) - 1 - r->end);
+    r->end += n;
+    r->eof = n == 0;
+  }
+}
+
+// Decode trace 'path' into a new image 'image_path'
+static int build_image(const char *path, const char *image_path, uint64_t key)
+{
+  line_reader_t *r = (line_reader_t *)calloc(1, sizeof(line_reader_t));
+  r->f = fopen(path, "rb");
+  if (r->f == NULL)
+  {
+    free(r);
+    return 0;
+  }
+  unsigned char magic[3] = {0, 0, 0};
+  if (fread(magic, 1, 3, r->f) == 3 && !memcmp(magic, "BZh", 3))
+  {
+    int error;
+    rewind(r->f);
+    r->bz = BZ2_bzReadOpen(&error, r->f, 0, 0, NULL, 0);
+    if (error != BZ_OK)
+    {
+      r->bz = NULL;
+      r->error = 1;
+    }
+  }
+  else
+  {
+    rewind(r->f);
+  }
+
+  // Written under a name of its own and renamed into place when complete,
+  // so concurrent runs building the same image never see a partial one
+  char tmp_path[4096];
+  FILE *out = NULL;
+  if (snprintf(tmp_path, sizeof(tmp_path), "%s.%d", image_path, (int)getpid()) < (int)sizeof(tmp_path))
+  {
+    out = fopen(tmp_path, "wb");
+  }
+  if (out == NULL)
+  {
+    fclose(r->f);
+    free(r);
+    return 0;
+  }
+
+  tracecache_header_t header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, TRACECACHE_MAGIC);
+  header.version = TRACECACHE_VERSION;
+  header.record_size = sizeof(trace_record_t);
+  header.key = key;
+  fseek(out, TRACECACHE_RECORDS_OFFSET, SEEK_SET);
+
+  trace_record_t last;
+  memset(&last, 0, sizeof(last));
+  char *line;
+  int ok = !r->error;
+  while (ok && (line = reader_line(r)) != NULL)
+  {
+    trace_parse_line(line, &last);
+    ok = fwrite(&last, sizeof(last), 1, out) == 1;
+    header.num_records++;
+    header.num_branches += (last.condition == 1);
+  }
+  // A partial image would be reused by every later run
+  ok = ok && !r->error;
+  if (r->bz)
+  {
+    int error;
+    BZ2_bzReadClose(&error, r->bz);
+  }
+  fclose(r->f);
+  free(r);
+
+  ok = ok && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, out) == 1;
+  ok = (fclose(out) == 0) && ok;
+  if (!ok || rename(tmp_path, image_path) != 0)
+  {
+    unlink(tmp_path);
+    return 0;
+  }
+  return 1;
+}
+
+// Map image 'image_path' if it is a valid image of 'key'
+static int map_image(const char *image_path, uint64_t key, trace_t *trace)
+{
+  int fd = open(image_path, O_RDONLY);
+  if (fd < 0)
+  {
+    return 0;
+  }
+  struct stat st;
+  tracecache_header_t header;
+  int ok = fstat(fd, &st) == 0 && read(fd, &header, sizeof(header)) == sizeof(header) &&
+           !memcmp(header.magic, TRACECACHE_MAGIC, sizeof(header.magic)) && header.version == TRACECACHE_VERSION &&
+           header.record_size == sizeof(trace_record_t) && header.key == key &&
+           (uint64_t)st.st_size == TRACECACHE_RECORDS_OFFSET + header.num_records * sizeof(trace_record_t);
+  void *map = MAP_FAILED;
+  if (ok)
+  {
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (map == MAP_FAILED)
+  {
+    return 0;
+  }
+
+  trace->records = (trace_record_t *)((char *)map + TRACECACHE_RECORDS_OFFSET);
+  trace->num_records = header.num_records;
+  trace->num_branches = header.num_branches;
+  return 1;
+}
+
+int tracecache_open(const char *dir, const char *path, trace_t *trace)
+{
+  uint64_t key;
+  if (!hash_file(path, &key))
+  {
+    fprintf(stderr, "Unable to read %s\n", path);
+    return 0;
+  }
+  char image_path[4096];
+  if (snprintf(image_path, sizeof(image_path), "%s/bptrace-%016" PRIx64 ".img", dir, key) >= (int)sizeof(image_path))
+  {
+    fprintf(stderr, "Cache directory %s is too long\n", dir);
+    return 0;
+  }
+
+  if (map_image(image_path, key, trace))
+  {
+    return 1;
+  }
+  if (!build_image(path, image_path, key) || !map_image(image_path, key, trace))
+  {
+    fprintf(stderr, "Unable to cache %s in %s\n", path, dir);
+    return 0;
+  }
+  return 1;
+}
+
+void tracecache_close(trace_t *trace)
+{
+  munmap((char *)trace->records - TRACECACHE_RECORDS_OFFSET,
+         TRACECACHE_RECORDS_OFFSET + trace->num_records * sizeof(trace_record_t));
+  trace->records = NULL;
+  trace->num_records = trace->num_branches = 0;
+}
@@ -0,0 +1,28 @@
+//========================================================//
+//  tracecache.h                                          //
+//  Header file for the decoded trace cache               //
+//                                                        //
+//  Decodes a trace file once into a binary image, named  //
+//  by a hash of the file, that later runs map read-only  //
+//========================================================//
+
+#ifndef TRACECACHE_H
+#define TRACECACHE_H
+
+#include "trace.h"
+
+// Default cache directory; tmpfs, so concurrent runs share the pages
+#define TRACECACHE_DIR "/dev/shm"
+
+// Map the decoded image of the text or bzip2-compressed trace 'path' from
+// 'dir' into 'trace', decoding it into the cache first if no run did so
+// yet. The records are read-only and shared with every other run using
+// the same image. Returns 0 on failure.
+//
+int tracecache_open(const char *dir, const char *path, trace_t *trace);
+
+// Unmap an image opened by tracecache_open
+//
+void tracecache_close(trace_t *trace);
+
+#endif
@@ -0,0 +1,340 @@
+//========================================================//
+//  tracefile.cpp                                         //
+//  Source file for the seekable trace container          //
+//                                                        //
+//  Written by `tracepack`, read by predictor when given  //
+//  a container instead of a text trace                   //
+//========================================================//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <bzlib.h>
+#include "tracefile.h"
+
+// Layout:
+//   header   magic, version, records per block
+//   blocks   bzip2-compressed arrays of trace_record_t
+//   index    one tracefile_block_t per block
+//   footer   index offset, counts, magic
+#define TRACEFILE_MAGIC "BPTRACE"
+#define TRACEFILE_FOOTER_MAGIC "BPINDEX"
+#define TRACEFILE_VERSION 1
+
+typedef struct
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t block_records;
+} tracefile_header_t;
+
+typedef struct
+{
+  uint64_t index_offset;
+  uint64_t num_blocks;
+  uint64_t num_records;
+  uint64_t num_branches;
+  char magic[8];
+} tracefile_footer_t;
+
+struct tracefile
+{
+  FILE *f;
+  tracefile_footer_t footer;
+  tracefile_block_t *index;
+  char *compressed;         // buffer for one compressed block
+  uint64_t compressed_size;
+  trace_record_t *records;  // the loaded block
+  uint64_t block;           // number of the loaded block, num_blocks if none
+  uint64_t next;            // next record within the loaded block
+};
+
+struct tracefile_writer
+{
+  FILE *f;
+  tracefile_block_t *index;
+  uint64_t num_blocks;
+  uint64_t index_size;
+  trace_record_t records[TRACEFILE_BLOCK_RECORDS];
+  uint32_t num_records;     // in the current block
+  uint32_t num_branches;
+  uint64_t total_records;
+  uint64_t total_branches;
+  char *compressed;
+  unsigned int compressed_size;
+};
+
+//------------------------------------//
+//              Reader                //
+//------------------------------------//
+
+int tracefile_probe(const char *path)
+{
+  tracefile_header_t header;
+  FILE *f = fopen(path, "rb");
+  if (f == NULL)
+  {
+    return 0;
+  }
+  int is_container = fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.magic, TRACEFILE_MAGIC, sizeof(header.magic));
+  fclose(f);
+  return is_container;
+}
+
+tracefile_t *tracefile_open(const char *path)
+{
+  tracefile_header_t header;
+  tracefile_t *tf = (tracefile_t *)calloc(1, sizeof(tracefile_t));
+  tf->f = fopen(path, "rb");
+  if (tf->f == NULL || fread(&header, sizeof(header), 1, tf->f) != 1 ||
+      memcmp(header.magic, TRACEFILE_MAGIC, sizeof(header.magic)) || header.version != TRACEFILE_VERSION ||
+      header.block_records != TRACEFILE_BLOCK_RECORDS ||
+      fseek(tf->f, -(long)sizeof(tracefile_footer_t), SEEK_END) ||
+      fread(&tf->footer, sizeof(tf->footer), 1, tf->f) != 1 ||
+      memcmp(tf->footer.magic, TRACEFILE_FOOTER_MAGIC, sizeof(tf->footer.magic)))
+  {
+    tracefile_close(tf);
+    return NULL;
+  }
+
+  uint64_t n = tf->footer.num_blocks;
+  tf->index = (tracefile_block_t *)malloc((n ? n : 1) * sizeof(tracefile_block_t));
+  if (fseek(tf->f, tf->footer.index_offset, SEEK_SET) || fread(tf->index, sizeof(tracefile_block_t), n, tf->f) != n)
+  {
+    tracefile_close(tf);
+    return NULL;
+  }
+  for (uint64_t b = 0; b < n; b++)
+  {
+    if (tf->index[b].size > tf->compressed_size)
+    {
+      tf->compressed_size = tf->index[b].size;
+    }
+  }
+  tf->compressed = (char *)malloc(tf->compressed_size ? tf->compressed_size : 1);
+  tf->records = (trace_record_t *)malloc(TRACEFILE_BLOCK_RECORDS * sizeof(trace_record_t));
+  tf->block = n;
+  tf->next = 0;
+
+  if (n)
+  {
+    tracefile_seek(tf, 0);
+  }
+  return tf;
+}
+
+void tracefile_close(tracefile_t *tf)
+{
+  if (tf->f)
+  {
+    fclose(tf->f);
+  }
+  free(tf->index);
+  free(tf->compressed);
+  free(tf->records);
+  free(tf);
+}
+
+uint64_t tracefile_records(const tracefile_t *tf)
+{
+  return tf->footer.num_records;
+}
+
+uint64_t tracefile_branches(const tracefile_t *tf)
+{
+  return tf->footer.num_branches;
+}
+
+uint64_t tracefile_num_blocks(const tracefile_t *tf)
+{
+  return tf->footer.num_blocks;
+}
+
+const tracefile_block_t *tracefile_block(const tracefile_t *tf, uint64_t block)
+{
+  return &tf->index[block];
+}
+
+static int load_block(tracefile_t *tf, uint64_t block)
+{
+  if (block == tf->block)
+  {
+    return 1;
+  }
+  const tracefile_block_t *b = &tf->index[block];
+  unsigned int size = b->num_records * sizeof(trace_record_t);
+  if (fseek(tf->f, b->offset, SEEK_SET) || fread(tf->compressed, 1, b->size, tf->f) != b->size ||
+      BZ2_bzBuffToBuffDecompress((char *)tf->records, &size, tf->compressed, b->size, 0, 0) != BZ_OK ||
+      size != b->num_records * sizeof(trace_record_t))
+  {
+    tf->block = tf->footer.num_blocks;
+    return 0;
+  }
+  tf->block = block;
+  return 1;
+}
+
+int tracefile_seek(tracefile_t *tf, uint64_t record)
+{
+  if (record >= tf->footer.num_records)
+  {
+    // Just past the end is a valid position with nothing left to read
+    tf->block = tf->footer.num_blocks;
+    tf->next = 0;
+    return record == tf->footer.num_records;
+  }
+  if (!load_block(tf, record / TRACEFILE_BLOCK_RECORDS))
+  {
+    return 0;
+  }
+  tf->next = record % TRACEFILE_BLOCK_RECORDS;
+  return 1;
+}
+
+int tracefile_next(tracefile_t *tf, trace_record_t *record)
+{
+  if (tf->block >= tf->footer.num_blocks)
+  {
+    return 0;
+  }
+  if (tf->next == tf->index[tf->block].num_records)
+  {
+    if (tf->block + 1 == tf->footer.num_blocks || !load_block(tf, tf->block + 1))
+    {
+      tf->block = tf->footer.num_blocks;
+      return 0;
+    }
+    tf->next = 0;
+  }
+  *record = tf->records[tf->next++];
+  return 1;
+}
+
+int tracefile_load(tracefile_t *tf, trace_t *trace)
+{
+  uint64_t first = tf->block < tf->footer.num_blocks ? tf->index[tf->block].first_record + tf->next
+                                                     : tf->footer.num_records;
+  uint64_t n = tf->footer.num_records - first;
+
+  trace->records = (trace_record_t *)malloc((n ? n : 1) * sizeof(trace_record_t));
+  trace->num_records = 0;
+  trace->num_branches = 0;
+  if (trace->records == NULL)
+  {
+    return 0;
+  }
+  trace_record_t *r = trace->records;
+  while (trace->num_records < n && tracefile_next(tf, r))
+  {
+    trace->num_branches += (r->condition == 1);
+    trace->num_records++;
+    r++;
+  }
+  return 1;
+}
+
+//------------------------------------//
+//              Writer                //
+//------------------------------------//
+
+tracefile_writer_t *tracefile_create(const char *path)
+{
+  tracefile_writer_t *w = (tracefile_writer_t *)calloc(1, sizeof(tracefile_writer_t));
+  w->f = fopen(path, "wb");
+  if (w->f == NULL)
+  {
+    free(w);
+    return NULL;
+  }
+
+  tracefile_header_t header;
+  memset(&header, 0, sizeof(header));
+  strcpy(header.magic, TRACEFILE_MAGIC);
+  header.version = TRACEFILE_VERSION;
+  header.block_records = TRACEFILE_BLOCK_RECORDS;
+  fwrite(&header, sizeof(header), 1, w->f);
+
+  // bzip2's worst case is 1% plus 600 bytes over the input
+  w->compressed_size = sizeof(w->records) + sizeof(w->records) / 100 + 600;
+  w->compressed = (char *)malloc(w->compressed_size);
+  w->index_size = 1024;
+  w->index = (tracefile_block_t *)malloc(w->index_size * sizeof(tracefile_block_t));
+  return w;
+}
+
+static int flush_block(tracefile_writer_t *w)
+{
+  if (w->num_records == 0)
+  {
+    return 1;
+  }
+  // Work factor 1 goes straight to bzip2's fallback sort, which is faster
+  // on the long repeats of fixed-size records
+  unsigned int size = w->compressed_size;
+  if (BZ2_bzBuffToBuffCompress(w->compressed, &size, (char *)w->records,
+                               w->num_records * sizeof(trace_record_t), 9, 0, 1) != BZ_OK)
+  {
+    return 0;
+  }
+
+  if (w->num_blocks == w->index_size)
+  {
+    w->index_size *= 2;
+    w->index = (tracefile_block_t *)realloc(w->index, w->index_size * sizeof(tracefile_block_t));
+  }
+  tracefile_block_t *b = &w->index[w->num_blocks++];
+  b->offset = ftell(w->f);
+  b->size = size;
+  b->first_record = w->total_records;
+  b->first_branch = w->total_branches;
+  b->num_records = w->num_records;
+  b->num_branches = w->num_branches;
+
+  w->total_records += w->num_records;
+  w->total_branches += w->num_branches;
+  w->num_records = 0;
+  w->num_branches = 0;
+  return fwrite(w->compressed, 1, size, w->f) == size;
+}
+
+int tracefile_write(tracefile_writer_t *w, const trace_record_t *record)
+{
+  // Field by field, so the padding compresses away and the output is
+  // the same from run to run
+  trace_record_t *r = &w->records[w->num_records++];
+  memset(r, 0, sizeof(*r));
+  r->pc = record->pc;
+  r->target = record->target;
+  r->outcome = record->outcome;
+  r->condition = record->condition;
+  r->call = record->call;
+  r->ret = record->ret;
+  r->direct = record->direct;
+  w->num_branches += (record->condition == 1);
+  if (w->num_records == TRACEFILE_BLOCK_RECORDS)
+  {
+    return flush_block(w);
+  }
+  return 1;
+}
+
+int tracefile_finish(tracefile_writer_t *w)
+{
+  int ok = flush_block(w);
+
+  tracefile_footer_t footer;
+  memset(&footer, 0, sizeof(footer));
+  footer.index_offset = ftell(w->f);
+  footer.num_blocks = w->num_blocks;
+  footer.num_records = w->total_records;
+  footer.num_branches = w->total_branches;
+  strcpy(footer.magic, TRACEFILE_FOOTER_MAGIC);
+
+  ok = ok && fwrite(w->index, sizeof(tracefile_block_t), w->num_blocks, w->f) == w->num_blocks &&
+       fwrite(&footer, sizeof(footer), 1, w->f) == 1;
+  ok = (fclose(w->f) == 0) && ok;
+
+  free(w->index);
+  free(w->compressed);
+  free(w);
+  return ok;
+}
@@ -0,0 +1,80 @@
+//========================================================//
+//  tracefile.h                                           //
+//  Header file for the seekable trace container          //
+//                                                        //
+//  Decoded records in independently bzip2-compressed     //
+//  blocks of a fixed number of records, indexed by a     //
+//  footer so any record is one block load away           //
+//========================================================//
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <stdint.h>
+#include "trace.h"
+
+// Records per block; all blocks but the last are full
+#define TRACEFILE_BLOCK_RECORDS (1 << 16)
+
+// Index entry of a block
+typedef struct
+{
+  uint64_t offset;          // byte offset of the compressed block
+  uint64_t size;            // compressed bytes
+  uint64_t first_record;    // number of the block's first record
+  uint64_t first_branch;    // conditional branches before the block
+  uint32_t num_records;
+  uint32_t num_branches;    // conditional branches in the block
+} tracefile_block_t;
+
+typedef struct tracefile tracefile_t;
+typedef struct tracefile_writer tracefile_writer_t;
+
+//------------------------------------//
+//              Reader                //
+//------------------------------------//
+
+// Whether 'path' is a trace container rather than a text trace
+//
+int tracefile_probe(const char *path);
+
+// Open the container 'path', positioned at its first record. Returns NULL
+// if it cannot be read or is not a container.
+//
+tracefile_t *tracefile_open(const char *path);
+void tracefile_close(tracefile_t *tf);
+
+uint64_t tracefile_records(const tracefile_t *tf);
+uint64_t tracefile_branches(const tracefile_t *tf);
+uint64_t tracefile_num_blocks(const tracefile_t *tf);
+const tracefile_block_t *tracefile_block(const tracefile_t *tf, uint64_t block);
+
+// Position at record number 'record', loading at most one block. Returns
+// 0 if the trace has fewer records.
+//
+int tracefile_seek(tracefile_t *tf, uint64_t record);
+
+// Read the next record; returns 0 at the end of the trace
+//
+int tracefile_next(tracefile_t *tf, trace_record_t *record);
+
+// Read every record from the current position into memory
+//
+int tracefile_load(tracefile_t *tf, trace_t *trace);
+
+//------------------------------------//
+//              Writer                //
+//------------------------------------//
+
+tracefile_writer_t *tracefile_create(const char *path);
+
+// Append a record; returns 0 on a write error
+//
+int tracefile_write(tracefile_writer_t *w, const trace_record_t *record);
+
+// Write the last block and the index, and close the file. Returns 0 on a
+// write error.
+//
+int tracefile_finish(tracefile_writer_t *w);
+
+#endif
@@ -0,0 +1,496 @@
+//========================================================//
+//  tracegen.cpp                                          //
+//  Synthetic branch trace generator                      //
+//                                                        //
+//  Writes traces in the simulator's 7-field format from  //
+//  a seeded program model. Built with `make tracegen`    //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
+
+//------------------------------------//
+//          Configuration             //
+//------------------------------------//
+
+// Conditional branches per chunk. Every chunk is generated from its own
+// seed, so the trace is the same whatever the number of threads.
+#define CHUNK_BRANCHES (1 << 20)
+
+// Kinds of static branch sites of the model
+enum
+{
+  SITE_LOOP,       // loop back edge with a fixed trip count, plus a body branch
+  SITE_CORRELATED, // random branch followed by one that repeats or inverts it
+  SITE_BIASED,     // mostly taken or mostly not taken
+  SITE_RANDOM,     // taken half of the time
+  SITE_CALL,       // call to a function running a few sites, then return
+  NUM_SITE_KINDS
+};
+
+static const char *site_kind_name[NUM_SITE_KINDS] = {"loop", "correlated", "biased", "random", "call"};
+
+uint64_t seed = 1;
+uint64_t num_branches = 10000000; // conditional branches to generate
+uint64_t footprint = 16384;       // static sites of the program
+uint64_t hot = 1024;              // sites in the working set of a chunk
+int trip_min = 2;                 // loop trip counts
+int trip_max = 64;
+int call_depth = 8;               // maximum call nesting
+int block = 6;                    // mean instructions per basic block
+int mix[NUM_SITE_KINDS] = {25, 15, 40, 10, 10};
+int threads = 1;
+const char *out_path = NULL;
+const char *info_path = NULL;
+
+//------------------------------------//
+//           Program model            //
+//------------------------------------//
+
+typedef struct
+{
+  int kind;
+  uint64_t pc;
+  uint64_t target;
+  uint32_t param; // trip count, taken per mille, inversion or callee size
+} site_t;
+
+static site_t *sites;
+
+static uint64_t splitmix(uint64_t *state)
+{
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// Lay out 'footprint' sites 16 to 64 bytes apart, kinds drawn from 'mix'
+static void build_program()
+{
+  uint64_t state = seed;
+  int mix_total = 0;
+  for (int k = 0; k < NUM_SITE_KINDS; k++)
+  {
+    mix_total += mix[k];
+  }
+
+  sites = (site_t *)malloc(footprint * sizeof(site_t));
+  uint64_t pc = 0x400000;
+  for (uint64_t i = 0; i < footprint; i++)
+  {
+    site_t *s = &sites[i];
+    int pick = splitmix(&state) % mix_total;
+    for (s->kind = 0; pick >= mix[s->kind]; s->kind++)
+    {
+      pick -= mix[s->kind];
+    }
+    pc += 16 + 4 * (splitmix(&state) % 13);
+    s->pc = pc;
+
+    uint64_t r = splitmix(&state);
+    switch (s->kind)
+    {
+    case SITE_LOOP:
+      s->target = pc - 16 - r % 256;
+      s->param = trip_min + (r >> 16) % (trip_max - trip_min + 1);
+      break;
+    case SITE_CORRELATED:
+      s->target = pc + 16 + r % 256;
+      s->param = (r >> 16) & 1;
+      break;
+    case SITE_BIASED:
+      s->target = pc + 16 + r % 256;
+      // 80.0% to 99.9% towards one direction
+      s->param = 800 + (r >> 16) % 200;
+      if ((r >> 32) & 1)
+      {
+        s->param = 1000 - s->param;
+      }
+      break;
+    case SITE_RANDOM:
+      s->target = pc + 16 + r % 256;
+      s->param = 500;
+      break;
+    case SITE_CALL:
+      s->target = 0x800000 + (r % footprint) * 64;
+      s->param = 1 + (r >> 32) % 8;
+      break;
+    }
+  }
+}
+
+//------------------------------------//
+//          Chunk generation          //
+//------------------------------------//
+
+typedef struct
+{
+  uint64_t index;
+  uint64_t rng;
+  uint64_t branches;     // conditional branches still to emit
+  uint64_t position;     // next site of the working set
+  uint64_t window;       // first site of the working set
+  char *buf;
+  size_t len;
+  size_t size;
+  uint64_t instructions; // counts for the info file
+  uint64_t conditional;
+  uint64_t unconditional;
+  uint64_t calls;
+  uint64_t rets;
+} chunk_t;
+
+static char *put_hex(char *p, uint64_t v)
+{
+  char digits[16];
+  int n = 0;
+  do
+  {
+    digits[n++] = "0123456789abcdef"[v & 15];
+    v >>= 4;
+  } while (v);
+  *p++ = '0';
+  *p++ = 'x';
+  while (n)
+  {
+    *p++ = digits[--n];
+  }
+  return p;
+}
+
+// Append one trace record; returns 0 once the chunk's quota of
+// conditional branches has been written
+static int emit(chunk_t *c, uint64_t pc, uint64_t target, int taken, int cond, int call, int ret, int direct)
+{
+  if (c->branches == 0)
+  {
+    return 0;
+  }
+  if (c->size - c->len < 64)
+  {
+    c->size *= 2;
+    c->buf = (char *)realloc(c->buf, c->size);
+  }
+
+  char *p = c->buf + c->len;
+  p = put_hex(p, pc);
+  *p++ = '\t';
+  p = put_hex(p, target);
+  *p++ = '\t';
+  *p++ = '0' + taken;
+  *p++ = '\t';
+  *p++ = '0' + cond;
+  *p++ = '\t';
+  *p++ = '0' + call;
+  *p++ = '\t';
+  *p++ = '0' + ret;
+  *p++ = '\t';
+  *p++ = '0' + direct;
+  *p++ = '\n';
+  c->len = p - c->buf;
+
+  c->instructions += 1 + splitmix(&c->rng) % (2 * block - 1);
+  if (cond)
+  {
+    c->conditional++;
+    c->branches--;
+  }
+  else
+  {
+    c->unconditional++;
+    c->calls += call;
+    c->rets += ret;
+  }
+  return 1;
+}
+
+static int emit_site(chunk_t *c, uint64_t i, int depth);
+
+// Run the 'count' sites after site 'first', as the body of a function
+static int emit_function(chunk_t *c, uint64_t first, uint32_t count, int depth)
+{
+  for (uint32_t j = 1; j <= count; j++)
+  {
+    if (!emit_site(c, (first + j) % footprint, depth))
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static int emit_site(chunk_t *c, uint64_t i, int depth)
+{
+  site_t *s = &sites[i];
+  uint64_t r;
+
+  switch (s->kind)
+  {
+  case SITE_LOOP:
+    for (uint32_t t = 1; t <= s->param; t++)
+    {
+      // The body branch is taken every third iteration
+      if (!emit(c, s->pc - 8, s->pc + 8, t % 3 == 0, 1, 0, 0, 1) ||
+          !emit(c, s->pc, s->target, t < s->param, 1, 0, 0, 1))
+      {
+        return 0;
+      }
+    }
+    return 1;
+  case SITE_CORRELATED:
+    r = splitmix(&c->rng);
+    return emit(c, s->pc - 8, s->pc + 64, r & 1, 1, 0, 0, 1) &&
+           emit(c, s->pc, s->target, (r & 1) ^ s->param, 1, 0, 0, 1);
+  case SITE_BIASED:
+  case SITE_RANDOM:
+    r = splitmix(&c->rng);
+    return emit(c, s->pc, s->target, r % 1000 < s->param, 1, 0, 0, 1);
+  case SITE_CALL:
+    if (depth >= call_depth)
+    {
+      return 1;
+    }
+    return emit(c, s->pc, s->target, 1, 0, 1, 0, 1) &&
+           emit_function(c, i, s->param, depth + 1) &&
+           emit(c, s->target + 32, s->pc + 5, 1, 0, 0, 1, 0);
+  }
+  return 1;
+}
+
+static void generate_chunk(chunk_t *c)
+{
+  c->rng = seed ^ (0xd1b54a32d192ed03ULL * (c->index + 1));
+  c->len = 0;
+  c->instructions = c->conditional = c->unconditional = c->calls = c->rets = 0;
+
+  // Each chunk runs its own working set of 'hot' consecutive sites in
+  // program order, with an occasional jump to anywhere in the program
+  c->window = splitmix(&c->rng) % footprint;
+  c->position = 0;
+  while (c->branches)
+  {
+    uint64_t r = splitmix(&c->rng);
+    uint64_t i;
+    if (r % 64 == 0)
+    {
+      i = (r >> 8) % footprint;
+    }
+    else
+    {
+      i = (c->window + c->position) % footprint;
+      c->position = (c->position + 1) % hot;
+    }
+    emit_site(c, i, 0);
+  }
+}
+
+static void *generate_worker(void *arg)
+{
+  generate_chunk((chunk_t *)arg);
+  return NULL;
+}
+
+//------------------------------------//
+//               Main                 //
+//------------------------------------//
+
+void usage()
+{
+  fprintf(stderr, "Usage: tracegen <options> [-o trace]\n");
+  fprintf(stderr, " Writes the trace to stdout unless -o is given\n");
+  fprintf(stderr, " Options:\n");
+  fprintf(stderr, " --seed=N          Seed of the program model and outcomes (default 1)\n");
+  fprintf(stderr, " --branches=N      Conditional branches to generate (default 10000000)\n");
+  fprintf(stderr, " --footprint=N     Static branch sites of the program (default 16384)\n");
+  fprintf(stderr, " --hot=N           Sites in the working set of each chunk (default 1024)\n");
+  fprintf(stderr, " --trips=MIN:MAX   Range of loop trip counts (default 2:64)\n");
+  fprintf(stderr, " --depth=N         Maximum call nesting (default 8)\n");
+  fprintf(stderr, " --block=N         Mean instructions per basic block (default 6)\n");
+  fprintf(stderr, " --mix=L,C,B,R,F   Weights of loop, correlated, biased, random and\n");
+  fprintf(stderr, "                   call sites (default 25,15,40,10,10)\n");
+  fprintf(stderr, " --threads=N       Generate N chunks at a time (default 1)\n");
+  fprintf(stderr, " --info=FILE       Write instruction and branch counts in the format of\n");
+  fprintf(stderr, "                   the traces/*.txt files\n");
+}
+
+int handle_option(char *arg)
+{
+  if (!strncmp(arg, "--seed=", 7))
+  {
+    seed = strtoull(arg + 7, NULL, 0);
+  }
+  else if (!strncmp(arg, "--branches=", 11))
+  {
+    num_branches = strtoull(arg + 11, NULL, 0);
+  }
+  else if (!strncmp(arg, "--footprint=", 12))
+  {
+    footprint = strtoull(arg + 12, NULL, 0);
+  }
+  else if (!strncmp(arg, "--hot=", 6))
+  {
+    hot = strtoull(arg + 6, NULL, 0);
+  }
+  else if (!strncmp(arg, "--trips=", 8))
+  {
+    if (sscanf(arg + 8, "%d:%d", &trip_min, &trip_max) != 2)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--depth=", 8))
+  {
+    call_depth = atoi(arg + 8);
+  }
+  else if (!strncmp(arg, "--block=", 8))
+  {
+    block = atoi(arg + 8);
+  }
+  else if (!strncmp(arg, "--mix=", 6))
+  {
+    if (sscanf(arg + 6, "%d,%d,%d,%d,%d", &mix[SITE_LOOP], &mix[SITE_CORRELATED],
+               &mix[SITE_BIASED], &mix[SITE_RANDOM], &mix[SITE_CALL]) != NUM_SITE_KINDS)
+    {
+      return 0;
+    }
+  }
+  else if (!strncmp(arg, "--threads=", 10))
+  {
+    threads = atoi(arg + 10);
+  }
+  else if (!strncmp(arg, "--info=", 7))
+  {
+    info_path = arg + 7;
+  }
+  else
+  {
+    return 0;
+  }
+  return 1;
+}
+
+int main(int argc, char *argv[])
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      usage();
+      exit(0);
+    }
+    else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+    {
+      out_path = argv[++i];
+    }
+    else if (!handle_option(argv[i]))
+    {
+      printf("Unrecognized option %s\n", argv[i]);
+      usage();
+      exit(1);
+    }
+  }
+
+  int mix_total = 0;
+  int mix_valid = 1;
+  for (int k = 0; k < NUM_SITE_KINDS; k++)
+  {
+    mix_total += mix[k];
+    mix_valid &= mix[k] >= 0;
+  }
+  if (footprint == 0 || hot == 0 || trip_min < 1 || trip_max < trip_min ||
+      block < 1 || threads < 1 || !mix_valid || mix_total == mix[SITE_CALL])
+  {
+    fprintf(stderr, "Invalid model parameters\n");
+    exit(1);
+  }
+
+  FILE *out = out_path ? fopen(out_path, "w") : stdout;
+  if (out == NULL)
+  {
+    fprintf(stderr, "Unable to open %s\n", out_path);
+    exit(1);
+  }
+
+  build_program();
+
+  chunk_t *chunks = (chunk_t *)calloc(threads, sizeof(chunk_t));
+  pthread_t *workers = (pthread_t *)malloc(threads * sizeof(pthread_t));
+  for (int t = 0; t < threads; t++)
+  {
+    chunks[t].size = 64 * CHUNK_BRANCHES;
+    chunks[t].buf = (char *)malloc(chunks[t].size);
+  }
+
+  uint64_t num_chunks = (num_branches + CHUNK_BRANCHES - 1) / CHUNK_BRANCHES;
+  uint64_t instructions = 0, conditional = 0, unconditional = 0, calls = 0, rets = 0;
+
+  for (uint64_t first = 0; first < num_chunks; first += threads)
+  {
+    int n = num_chunks - first < (uint64_t)threads ? num_chunks - first : threads;
+    for (int t = 0; t < n; t++)
+    {
+      chunk_t *c = &chunks[t];
+      c->index = first + t;
+      c->branches = c->index == num_chunks - 1 ? num_branches - c->index * CHUNK_BRANCHES : CHUNK_BRANCHES;
+      pthread_create(&workers[t], NULL, generate_worker, c);
+    }
+    for (int t = 0; t < n; t++)
+    {
+      chunk_t *c = &chunks[t];
+      pthread_join(workers[t], NULL);
+      fwrite(c->buf, 1, c->len, out);
+      instructions += c->instructions;
+      conditional += c->conditional;
+      unconditional += c->unconditional;
+      calls += c->calls;
+      rets += c->rets;
+    }
+  }
+
+  if (out != stdout)
+  {
+    fclose(out);
+  }
+  else
+  {
+    fflush(stdout);
+  }
+
+  if (info_path)
+  {
+    FILE *info = fopen(info_path, "w");
+    if (info == NULL)
+    {
+      fprintf(stderr, "Unable to open %s\n", info_path);
+      exit(1);
+    }
+    fprintf(info, "!!! Number of Instructions = %" PRIu64 "\n", instructions);
+    fprintf(info, "!!! Number of Unconditional branches = %" PRIu64 "\n", unconditional);
+    fprintf(info, "!!! Number of Conditional branches = %" PRIu64 "\n", conditional);
+    fprintf(info, "!!! Number of Call branches = %" PRIu64 "\n", calls);
+    fprintf(info, "!!! Number of Ret branches = %" PRIu64 "\n", rets);
+    fprintf(info, "!!! Model: seed %" PRIu64 ", footprint %" PRIu64 ", hot %" PRIu64
+                  ", trips %d:%d, mix",
+            seed, footprint, hot, trip_min, trip_max);
+    for (int k = 0; k < NUM_SITE_KINDS; k++)
+    {
+      fprintf(info, " %s=%d", site_kind_name[k], mix[k]);
+    }
+    fprintf(info, "\n");
+    fclose(info);
+  }
+
+  for (int t = 0; t < threads; t++)
+  {
+    free(chunks[t].buf);
+  }
+  free(chunks);
+  free(workers);
+  free(sites);
+
+  return 0;
+}
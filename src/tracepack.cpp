@@ -0,0 +1,119 @@
+//========================================================//
+//  tracepack.cpp                                         //
+//  Converts text traces to seekable trace containers     //
+//                                                        //
+//  Built with `make tracepack`, see tracefile.h          //
+//========================================================//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "trace.h"
+#include "tracefile.h"
+
+void usage()
+{
+  fprintf(stderr, "Usage: tracepack [<text trace>] <container>\n");
+  fprintf(stderr, "       bunzip2 -kc trace.bz2 | tracepack <container>\n");
+  fprintf(stderr, "       tracepack --list <container>\n");
+  fprintf(stderr, "       tracepack --unpack <container>\n");
+  fprintf(stderr, " Packs a text trace (stdin if not given) into a container, lists the\n");
+  fprintf(stderr, " blocks of a container, or writes a container back out as text\n");
+}
+
+int pack(FILE *in, const char *path)
+{
+  tracefile_writer_t *w = tracefile_create(path);
+  if (w == NULL)
+  {
+    fprintf(stderr, "Unable to create %s\n", path);
+    return 1;
+  }
+
+  char *buf = NULL;
+  size_t len = 0;
+  trace_record_t record = {0, 0, 0, 0, 0, 0, 0};
+  int ok = 1;
+  while (ok && getline(&buf, &len, in) != -1)
+  {
+    trace_parse_line(buf, &record);
+    ok = tracefile_write(w, &record);
+  }
+  free(buf);
+
+  if (!tracefile_finish(w) || !ok)
+  {
+    fprintf(stderr, "Error writing %s\n", path);
+    return 1;
+  }
+  return 0;
+}
+
+int list(const char *path)
+{
+  tracefile_t *tf = tracefile_open(path);
+  if (tf == NULL)
+  {
+    fprintf(stderr, "%s is not a trace container\n", path);
+    return 1;
+  }
+  printf("%s: %" PRIu64 " records, %" PRIu64 " conditional branches, %" PRIu64 " blocks\n", path,
+         tracefile_records(tf), tracefile_branches(tf), tracefile_num_blocks(tf));
+  printf("%8s %12s %10s %12s %12s %8s %8s\n", "Block", "Offset", "Size", "First rec", "First br", "Records", "Branches");
+  for (uint64_t i = 0; i < tracefile_num_blocks(tf); i++)
+  {
+    const tracefile_block_t *b = tracefile_block(tf, i);
+    printf("%8" PRIu64 " %12" PRIu64 " %10" PRIu64 " %12" PRIu64 " %12" PRIu64 " %8u %8u\n", i, b->offset, b->size,
+           b->first_record, b->first_branch, b->num_records, b->num_branches);
+  }
+  tracefile_close(tf);
+  return 0;
+}
+
+int unpack(const char *path)
+{
+  tracefile_t *tf = tracefile_open(path);
+  if (tf == NULL)
+  {
+    fprintf(stderr, "%s is not a trace container\n", path);
+    return 1;
+  }
+  trace_record_t r;
+  while (tracefile_next(tf, &r))
+  {
+    printf("0x%" PRIx64 "\t0x%" PRIx64 "\t%d\t%d\t%d\t%d\t%d\n", r.pc, r.target, r.outcome, r.condition, r.call, r.ret, r.direct);
+  }
+  tracefile_close(tf);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc == 3 && !strcmp(argv[1], "--list"))
+  {
+    return list(argv[2]);
+  }
+  if (argc == 3 && !strcmp(argv[1], "--unpack"))
+  {
+    return unpack(argv[2]);
+  }
+  if (argc == 2 && strncmp(argv[1], "--", 2))
+  {
+    return pack(stdin, argv[1]);
+  }
+  if (argc == 3 && strncmp(argv[1], "--", 2))
+  {
+    FILE *in = fopen(argv[1], "r");
+    if (in == NULL)
+    {
+      fprintf(stderr, "Unable to open %s\n", argv[1]);
+      return 1;
+    }
+    int status = pack(in, argv[2]);
+    fclose(in);
+    return status;
+  }
+  usage();
+  return argc == 2 && !strcmp(argv[1], "--help") ? 0 : 1;
+}